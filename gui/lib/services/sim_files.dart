@@ -0,0 +1,17 @@
+/// Simulator sources bundled under assets/sim/ and copied into every <RTL>/sim/ workspace.
+///
+/// The files live only in the repository's top-level sim/ directory;
+/// tool/copy_sim_assets.dart copies them into assets/sim/ before a build.
+const simSourceFiles = [
+  'simulator.cpp',
+  'design_plugin.cpp',
+  'design_plugin.h',
+  'pyvga.cpp',
+  'selftest.cpp',
+  'perf_lint.py',
+  'rtl_profile.py',
+  'fuzz.py',
+];
+
+/// Build script, copied separately so its line endings and mode can be fixed up
+const simScriptFile = 'run_simulation.sh';
@@ -3,6 +3,7 @@ import 'package:flutter/services.dart';
 import 'package:path/path.dart' as path;
 import 'board_generator.dart';
 import 'platform_helper.dart';
+import 'sim_files.dart';
 
 /// Responsible for creating and managing the <RTL>/sim/ workspace
 class WorkspaceService {
@@ -19,14 +20,16 @@ class WorkspaceService {
       await dir.create(recursive: true);
     }
 
-    // 1. Copy simulator.cpp
-    final simCpp = await rootBundle.loadString('assets/sim/simulator.cpp');
-    await File(path.join(simDir, 'simulator.cpp')).writeAsString(simCpp);
+    // 1. Copy simulator.cpp, the design plugin, pyvga and self-test sources and the Python helpers
+    for (final name in simSourceFiles) {
+      final source = await rootBundle.loadString('assets/sim/$name');
+      await File(path.join(simDir, name)).writeAsString(source);
+    }
 
     // 2. Copy run_simulation.sh (ensure LF line endings)
-    final simShRaw = await rootBundle.loadString('assets/sim/run_simulation.sh');
+    final simShRaw = await rootBundle.loadString('assets/sim/$simScriptFile');
     final simSh = simShRaw.replaceAll('\r\n', '\n');
-    final shFile = File(path.join(simDir, 'run_simulation.sh'));
+    final shFile = File(path.join(simDir, simScriptFile));
     await shFile.writeAsString(simSh);
 
     // Set executable permission (non-Windows)
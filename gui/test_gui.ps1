@@ -12,6 +12,17 @@ Write-Host "Source: $sourceDir"
 Write-Host "Proxy:  $proxyDir"
 Write-Host ""
 
+# ============ Simulator sources: copy ../sim into assets/sim ============
+
+Write-Host "Copying simulator sources into assets/sim..."
+Set-Location $sourceDir
+dart run tool/copy_sim_assets.dart
+if ($LASTEXITCODE -ne 0) {
+    Write-Host "Copying the simulator sources failed!" -ForegroundColor Red
+    return
+}
+Write-Host ""
+
 # ============ Smart Detection: Can proxy directory be reused? ============
 
 $needRebuild = $false
@@ -0,0 +1,24 @@
+// Copies the simulator sources from the repository's sim/ directory into assets/sim/.
+// Run from gui/ after `flutter pub get` and before `flutter build`:
+//
+//   dart run tool/copy_sim_assets.dart
+import 'dart:io';
+
+import 'package:vga_launcher/services/sim_files.dart';
+
+void main() {
+  final guiDir = File(Platform.script.toFilePath()).parent.parent;
+  final sourceDir = Directory('${guiDir.path}/../sim');
+  final assetDir = Directory('${guiDir.path}/assets/sim');
+  assetDir.createSync(recursive: true);
+
+  for (final name in [...simSourceFiles, simScriptFile]) {
+    final source = File('${sourceDir.path}/$name');
+    if (!source.existsSync()) {
+      stderr.writeln('copy_sim_assets: ${source.path} not found');
+      exit(1);
+    }
+    source.copySync('${assetDir.path}/$name');
+  }
+  stdout.writeln('Copied ${simSourceFiles.length + 1} simulator files into ${assetDir.path}');
+}
@@ -0,0 +1,196 @@
+// Design side of the plugin ABI (see design_plugin.h). Verilated together with
+// DevelopmentBoard.v and linked into a shared object by run_simulation.sh.
+#include "verilated.h"
+#include "verilated_save.h"
+#include "VDevelopmentBoard.h"            // from Verilating "DevelopmentBoard.v"
+#include "design_plugin.h"
+#include "vga_probes.h"                   // written into obj_dir by run_simulation.sh
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(_WIN32)
+#define VGA_DESIGN_EXPORT extern "C" __declspec(dllexport)
+#else
+#define VGA_DESIGN_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+static uint64_t plugin_time = 0;  // current simulation time, set by the host
+double sc_time_stamp() {        // called by $time in Verilog
+    return plugin_time;
+}
+
+static void copy_inputs(VDevelopmentBoard* model, const VgaDesignPorts* ports) {
+    model->clk = ports->clk;
+    model->reset = ports->reset;
+    model->B2 = ports->B2;
+    model->B3 = ports->B3;
+    model->B4 = ports->B4;
+    model->B5 = ports->B5;
+}
+
+static void copy_outputs(const VDevelopmentBoard* model, VgaDesignPorts* ports) {
+    ports->h_sync = model->h_sync;
+    ports->v_sync = model->v_sync;
+    ports->rgb = model->rgb;
+    ports->led1 = model->led1;
+    ports->led2 = model->led2;
+    ports->led3 = model->led3;
+    ports->led4 = model->led4;
+    ports->led5 = model->led5;
+}
+
+static void* design_create(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);   // remember args
+    return new VDevelopmentBoard;
+}
+
+static void design_destroy(void* design) {
+    VDevelopmentBoard* model = static_cast<VDevelopmentBoard*>(design);
+    model->final();
+    delete model;
+}
+
+static void design_eval(void* design, VgaDesignPorts* ports, uint64_t time) {
+    VDevelopmentBoard* model = static_cast<VDevelopmentBoard*>(design);
+    plugin_time = time;
+    copy_inputs(model, ports);
+    model->eval();
+    copy_outputs(model, ports);
+}
+
+static uint64_t design_run_pixels(void* design, VgaDesignPorts* ports, uint64_t time,
+                                  int clocks_per_pixel, uint32_t sync_xor,
+                                  uint32_t* samples, int count) {
+    VDevelopmentBoard* model = static_cast<VDevelopmentBoard*>(design);
+    copy_inputs(model, ports);
+    for (int i = 0; i < count; i++) {
+        for (int t = 0; t < clocks_per_pixel; t++) {
+            plugin_time = ++time;
+            model->clk = 1;
+            model->eval();
+            plugin_time = ++time;
+            model->clk = 0;
+            model->eval();
+        }
+        samples[i] = ((uint32_t)model->rgb | ((uint32_t)(model->h_sync & 1) << 16) |
+                      ((uint32_t)(model->v_sync & 1) << 17)) ^ sync_xor;
+    }
+    ports->clk = model->clk;
+    copy_outputs(model, ports);
+    return time;
+}
+
+static int design_got_finish(void*) {
+    return Verilated::gotFinish() ? 1 : 0;
+}
+
+// Verilator only ships file-based VerilatedSave/VerilatedRestore; checkpoints
+// stay in memory, so serialise through the buffer of the base classes directly
+class MemorySave final : public VerilatedSerialize {
+public:
+    explicit MemorySave(std::vector<uint8_t>& out) : m_out(out) {
+        m_out.clear();
+        m_isOpen = true;
+    }
+    ~MemorySave() override { close(); }
+    void close() override {
+        flush();
+        m_isOpen = false;
+    }
+    void flush() override {
+        m_out.insert(m_out.end(), m_bufp, m_cp);
+        m_cp = m_bufp;
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+};
+
+class MemoryRestore final : public VerilatedDeserialize {
+public:
+    MemoryRestore(const uint8_t* data, size_t size) : m_data(data), m_left(size) {
+        m_isOpen = true;
+        m_cp = m_endp = m_bufp;
+    }
+
+protected:
+    void fill() override {
+        if (m_left == 0) return;        // Everything left is already buffered
+        // Keep the unread bytes, then top the buffer up from the snapshot
+        size_t kept = m_endp - m_cp;
+        std::memmove(m_bufp, m_cp, kept);
+        size_t n = std::min(m_left, bufferSize() - kept);
+        std::memcpy(m_bufp + kept, m_data, n);
+        m_data += n;
+        m_left -= n;
+        m_cp = m_bufp;
+        m_endp = m_bufp + kept + n;
+    }
+
+private:
+    const uint8_t* m_data;
+    size_t m_left;
+};
+
+static std::vector<uint8_t> saved_state;
+
+static const uint8_t* design_save_state(void* design, size_t* size) {
+    VDevelopmentBoard* model = static_cast<VDevelopmentBoard*>(design);
+    {
+        MemorySave os(saved_state);
+        os << *model;
+    }
+    *size = saved_state.size();
+    return saved_state.data();
+}
+
+static int design_restore_state(void* design, const uint8_t* data, size_t size) {
+    VDevelopmentBoard* model = static_cast<VDevelopmentBoard*>(design);
+    MemoryRestore is(data, size);
+    is >> *model;
+    return 0;
+}
+
+// Probes: vga_probes.h defines VGA_PROBES(X) with one X("path", member) per
+// signal of probes.txt that Verilator kept public, and VGA_PROBE_ROOT(model)
+// for the object holding those members (the root class since Verilator 4.210)
+#define VGA_PROBE_NAME(name, member) name,
+static const char* const probe_names[] = {VGA_PROBES(VGA_PROBE_NAME) nullptr};
+static const int probe_total = (int)(sizeof(probe_names) / sizeof(probe_names[0])) - 1;
+
+static int design_probe_count(void*) {
+    return probe_total;
+}
+
+static const char* design_probe_name(void*, int index) {
+    return index >= 0 && index < probe_total ? probe_names[index] : nullptr;
+}
+
+static void design_read_probes(void* design, uint64_t* values) {
+    VDevelopmentBoard* model = static_cast<VDevelopmentBoard*>(design);
+    int i = 0;
+#define VGA_PROBE_READ(name, member) values[i++] = (uint64_t)VGA_PROBE_ROOT(model)->member;
+    VGA_PROBES(VGA_PROBE_READ)
+    (void)model;
+    (void)values;
+    (void)i;
+}
+
+VGA_DESIGN_EXPORT const VgaDesignApi* vga_design_api(void) {
+    static const VgaDesignApi api = {
+        VGA_DESIGN_ABI_VERSION,
+        sizeof(VgaDesignPorts),
+        design_create,
+        design_destroy,
+        design_eval,
+        design_run_pixels,
+        design_got_finish,
+        design_save_state,
+        design_restore_state,
+        design_probe_count,
+        design_probe_name,
+        design_read_probes,
+    };
+    return &api;
+}
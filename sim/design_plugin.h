@@ -0,0 +1,86 @@
+// C ABI between the simulator host (simulator.cpp: window, event loop,
+// framebuffer) and a design plugin (design_plugin.cpp compiled together with
+// the Verilated DevelopmentBoard into a shared object).
+//
+// The host loads the plugin with dlopen(), looks up VGA_DESIGN_ENTRY and only
+// ever talks to the design through the returned function table, so a rebuilt
+// plugin can be swapped in without restarting the host.
+#ifndef VGA_DESIGN_PLUGIN_H
+#define VGA_DESIGN_PLUGIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bump when VgaDesignPorts or VgaDesignApi change incompatibly
+#define VGA_DESIGN_ABI_VERSION 3
+
+// Name of the exported entry point returning the function table
+#define VGA_DESIGN_ENTRY "vga_design_api"
+
+// Top-level ports of DevelopmentBoard. Inputs are copied into the model before
+// every evaluation; outputs are copied back after it.
+typedef struct VgaDesignPorts {
+    // Inputs
+    uint8_t clk;
+    uint8_t reset;
+    uint8_t B2, B3, B4, B5;
+    // Outputs
+    uint8_t h_sync;
+    uint8_t v_sync;
+    uint16_t rgb;
+    uint8_t led1, led2, led3, led4, led5;
+} VgaDesignPorts;
+
+typedef struct VgaDesignApi {
+    uint32_t abi_version;           // VGA_DESIGN_ABI_VERSION the plugin was built with
+    uint32_t ports_size;            // sizeof(VgaDesignPorts) the plugin was built with
+
+    // Create a model; argv carries +verilator+ plusargs. Returns NULL on failure.
+    void* (*create)(int argc, char** argv);
+    void (*destroy)(void* design);
+
+    // Evaluate once with the given inputs at simulation time `time`
+    void (*eval)(void* design, VgaDesignPorts* ports, uint64_t time);
+
+    // Run `count` pixels of `clocks_per_pixel` full clocks each, starting at
+    // `time`. After each pixel the outputs are packed into samples[i] as
+    // rgb | h_sync << 16 | v_sync << 17, XORed with `sync_xor`. Inputs are
+    // read once at the start; outputs are written back at the end. Returns the
+    // simulation time after the last clock.
+    uint64_t (*run_pixels)(void* design, VgaDesignPorts* ports, uint64_t time,
+                           int clocks_per_pixel, uint32_t sync_xor,
+                           uint32_t* samples, int count);
+
+    // Non-zero once the design executed $finish
+    int (*got_finish)(void* design);
+
+    // Serialise the model state (Verilator --savable). Returns a buffer owned
+    // by the plugin that stays valid until the next call, and its size in *size.
+    const uint8_t* (*save_state)(void* design, size_t* size);
+
+    // Restore a state returned by save_state of the same plugin. Returns 0 on success.
+    int (*restore_state)(void* design, const uint8_t* data, size_t size);
+
+    // Internal signals listed in probes.txt (see run_simulation.sh) that the
+    // build made readable, e.g. "vga_pic_inst.ball_x". Returns their number.
+    int (*probe_count)(void* design);
+
+    // Name of probe `index` as written in probes.txt, or NULL if out of range
+    const char* (*probe_name)(void* design, int index);
+
+    // Current value of every probe into values[0..probe_count), zero-extended;
+    // signals wider than 64 bits are left out by the build
+    void (*read_probes)(void* design, uint64_t* values);
+} VgaDesignApi;
+
+typedef const VgaDesignApi* (*VgaDesignEntryFn)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VGA_DESIGN_PLUGIN_H
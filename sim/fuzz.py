@@ -0,0 +1,309 @@
+#!/usr/bin/env python3
+"""Randomised button fuzzing of a built design.
+
+Many headless simulator instances run in parallel, each pressing B2..B5 from
+its own seeded schedule (written as an --input-script). Every run checks the
+invariants: the watchdog (sync lost or image frozen), the sync timing reports
+(--strict-timing) and optional per-frame pixel predicates (--pixel-check).
+With --strategy coverage, schedules that produce frames never seen before are
+kept in a corpus and mutated, which reaches deep button sequences faster than
+independent random schedules.
+
+Every distinct failure is shrunk to a minimal button script that still fails
+the same way, and saved under WORK/failures/ ready for --input-script.
+
+Usage:
+    python3 fuzz.py [--design PLUGIN] [--host EXE] [--runs N] [--frames N]
+                    [--jobs N] [--seed N] [--strategy random|coverage]
+                    [--buttons B2,B3,...] [--pixel-check FILE]
+                    [--work DIR] [--timeout SEC] [--sim-arg ARG ...]
+"""
+import argparse
+import concurrent.futures
+import glob
+import json
+import os
+import random
+import re
+import subprocess
+import sys
+
+# Simulator exit codes (see simulator.cpp)
+EXIT_CODES = {0: 'ok', 1: 'startup failure', 2: 'bad option', 3: 'no h_sync', 4: 'no v_sync',
+              5: 'frozen image', 6: 'diverged from reference', 7: 'invariant failed'}
+
+MEAN_GAP_FRAMES = 12        # Mean frames between button edges in a fresh schedule
+MEAN_HOLD_FRAMES = 20       # Mean frames a button is held
+
+
+def find_host():
+    """The host run_simulation.sh built: obj_dir/vga_host or the newest cached one"""
+    if os.path.exists('obj_dir/vga_host'):
+        return 'obj_dir/vga_host'
+    cache = os.environ.get('VGA_SIM_CACHE') or os.path.join(
+        os.environ.get('XDG_CACHE_HOME') or os.path.expanduser('~/.cache'), 'vga-simulator')
+    hosts = glob.glob(os.path.join(cache, 'host-*', 'vga_host'))
+    return max(hosts, key=os.path.getmtime) if hosts else None
+
+
+# A schedule is a list of presses (frame, button, hold frames); each becomes a
+# press and a release edge in the input script
+def random_schedule(rng, frames, buttons):
+    presses = []
+    frame = int(rng.expovariate(1.0 / MEAN_GAP_FRAMES))
+    while frame < frames:
+        presses.append((frame, rng.choice(buttons), 1 + int(rng.expovariate(1.0 / MEAN_HOLD_FRAMES))))
+        frame += 1 + int(rng.expovariate(1.0 / MEAN_GAP_FRAMES))
+    return presses
+
+
+def mutate_schedule(rng, presses, frames, buttons):
+    presses = list(presses)
+    for _ in range(1 + int(rng.expovariate(0.7))):
+        op = rng.randrange(5)
+        if op == 0 or not presses:
+            presses.append((rng.randrange(frames), rng.choice(buttons), 1 + int(rng.expovariate(1.0 / MEAN_HOLD_FRAMES))))
+        elif op == 1:
+            presses.pop(rng.randrange(len(presses)))
+        elif op == 2:
+            i = rng.randrange(len(presses))
+            f, b, h = presses[i]
+            presses[i] = (max(0, f + rng.randint(-30, 30)), b, h)
+        elif op == 3:
+            i = rng.randrange(len(presses))
+            f, b, h = presses[i]
+            presses[i] = (f, b, max(1, int(h * rng.choice((0.25, 0.5, 2, 4)))))
+        else:
+            i = rng.randrange(len(presses))
+            f, b, h = presses[i]
+            presses[i] = (f, rng.choice(buttons), h)
+    return sorted(p for p in presses if p[0] < frames)
+
+
+def script_edges(presses):
+    """Input script edges for a schedule; overlapping presses of one button merge"""
+    held = {}       # button -> release frame
+    events = []
+    for frame, button, hold in sorted(presses):
+        if button in held and frame <= held[button]:
+            held[button] = max(held[button], frame + hold)
+            continue
+        if button in held:
+            events.append((held[button], button, 'release'))
+        events.append((frame, button, 'press'))
+        held[button] = frame + hold
+    events += [(frame, button, 'release') for button, frame in held.items()]
+    return sorted(events, key=lambda e: (e[0], e[2] == 'press'))
+
+
+def write_script(path, presses, header=()):
+    with open(path, 'w', encoding='utf-8') as f:
+        for line in header:
+            f.write('# %s\n' % line)
+        for frame, button, action in script_edges(presses):
+            f.write('%d %s %s\n' % (frame, button, action))
+
+
+class Run:
+    def __init__(self, seed, presses, parent=None):
+        self.seed = seed
+        self.presses = presses
+        self.parent = parent    # Seed of the corpus entry this was mutated from
+        self.exit_code = None
+        self.status = ''
+        self.frames = 0
+        self.hashes = set()
+        self.diagnostic = []
+
+    def failed(self):
+        return self.exit_code != 0
+
+    def signature(self):
+        """What failed, without frame numbers, so repeats of one bug group together"""
+        first = self.diagnostic[0] if self.diagnostic else ''
+        return '%s | %s' % (self.status, re.sub(r'\d+', 'N', first))
+
+
+class Fuzzer:
+    def __init__(self, args):
+        self.args = args
+        self.buttons = args.buttons.split(',')
+        os.makedirs(os.path.join(args.work, 'scripts'), exist_ok=True)
+        os.makedirs(os.path.join(args.work, 'failures'), exist_ok=True)
+
+    def command(self, script, frames):
+        cmd = [os.path.abspath(self.args.host), '--design=' + os.path.abspath(self.args.design), '--headless',
+               '--frames=%d' % frames, '--hash-every=1', '--timing-report=%d' % self.args.timing_report,
+               '--strict-timing', '--watchdog-frames=%d' % self.args.watchdog_frames,
+               '--input-script=' + os.path.abspath(script)]
+        if self.args.pixel_check:
+            cmd.append('--pixel-check=' + os.path.abspath(self.args.pixel_check))
+        return cmd + self.args.sim_arg
+
+    def execute(self, run, name, frames=None):
+        """Run one schedule headless and collect its frame hashes and failure"""
+        script = os.path.join(self.args.work, 'scripts', name + '.txt')
+        write_script(script, run.presses)
+        try:
+            result = subprocess.run(self.command(script, frames or self.args.frames), capture_output=True,
+                                    text=True, timeout=self.args.timeout)
+            output, run.exit_code = result.stdout + result.stderr, result.returncode
+            run.status = EXIT_CODES.get(result.returncode, 'exit code %d' % result.returncode)
+        except subprocess.TimeoutExpired as e:
+            output = (e.stderr or b'').decode(errors='replace')
+            run.exit_code, run.status = -1, 'timeout'
+        for text in output.splitlines():
+            m = re.match(r'^\[Hash\] Frame (\d+) ([0-9a-f]+)', text)
+            if m:
+                run.frames = int(m.group(1))
+                run.hashes.add(m.group(2))
+            elif text.startswith(('[Check] Frame', '[Timing]   ', '[Watchdog]')) and 'Stopped after' not in text:
+                run.diagnostic.append(text)
+            elif text.startswith('Failed to load'):
+                run.diagnostic.append(text)
+        os.remove(script)
+        return run
+
+    def still_fails(self, run, presses, frames, name):
+        trial = self.execute(Run(run.seed, presses), name, frames)
+        return trial.failed() and trial.signature() == run.signature()
+
+    def minimize(self, run, pool):
+        """Delta debugging over the presses; candidate subsets are tried in parallel"""
+        frames = min(self.args.frames, run.frames + 2)
+        presses = [p for p in run.presses if p[0] <= frames]
+        if not self.still_fails(run, presses, frames, 'min-%d' % run.seed):
+            presses = run.presses
+            frames = self.args.frames
+        chunks = 2
+        while len(presses) >= 2:
+            size = (len(presses) + chunks - 1) // chunks
+            parts = [presses[i:i + size] for i in range(0, len(presses), size)]
+            candidates = parts + ([[p for k, part in enumerate(parts) if k != i for p in part]
+                                   for i in range(len(parts))] if len(parts) > 2 else [])
+            futures = [pool.submit(self.still_fails, run, c, frames, 'min-%d-%d' % (run.seed, i))
+                       for i, c in enumerate(candidates)]
+            smaller = next((c for c, f in zip(candidates, futures) if f.result()), None)
+            if smaller is not None:
+                presses = smaller
+                chunks = 2 if smaller in parts else max(chunks - 1, 2)
+            elif size == 1:
+                break
+            else:
+                chunks = min(len(presses), chunks * 2)
+        if len(presses) == 1 and self.still_fails(run, [], frames, 'min-%d-empty' % run.seed):
+            presses = []
+        # Shorter holds are easier to read; keep a shortened hold only if it still fails
+        for i, (f, b, h) in enumerate(presses):
+            if h > 1:
+                shorter = presses[:i] + [(f, b, 1)] + presses[i + 1:]
+                if self.still_fails(run, shorter, frames, 'min-%d-hold' % run.seed):
+                    presses = shorter
+        return presses, frames
+
+    def save_failure(self, run, presses, frames, index):
+        kind = re.sub(r'\W+', '_', run.status).strip('_')
+        path = os.path.join(self.args.work, 'failures', '%02d_%s_seed%d.txt' % (index, kind, run.seed))
+        header = ['%s after %d frames (seed %d, %d presses shrunk to %d)' % (run.status, run.frames, run.seed,
+                                                                           len(run.presses), len(presses))]
+        header += [d.strip() for d in run.diagnostic[:3]]
+        header.append('Reproduce: %s' % ' '.join(self.command(path, frames)))
+        write_script(path, presses, header)
+        write_script(path.replace('.txt', '_full.txt'), run.presses, header[:1])
+        return path
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Fuzz the buttons of a built design on all cores.')
+    parser.add_argument('--design', default='obj_dir/design.so', help='Design plugin (default obj_dir/design.so)')
+    parser.add_argument('--host', help='Simulator host (default obj_dir/vga_host or the cached one)')
+    parser.add_argument('--runs', type=int, default=64, help='Schedules to try (default 64)')
+    parser.add_argument('--frames', type=int, default=600, help='Frames per run (default 600)')
+    parser.add_argument('--jobs', type=int, default=os.cpu_count() or 1, help='Runs at the same time (default: all cores)')
+    parser.add_argument('--seed', type=int, default=1, help='Seed of the first run; run i uses SEED+i (default 1)')
+    parser.add_argument('--strategy', choices=('random', 'coverage'), default='coverage',
+                        help='Fresh random schedules only, or also mutate the ones that reached new frames (default)')
+    parser.add_argument('--buttons', default='B2,B3,B4,B5', help='Buttons to press (default B2,B3,B4,B5)')
+    parser.add_argument('--pixel-check', help='Per-frame pixel invariants (see --pixel-check in the simulator)')
+    parser.add_argument('--timing-report', type=int, default=10, help='Check the sync timing every N frames (default 10)')
+    parser.add_argument('--watchdog-frames', type=int, default=0,
+                        help='Fail runs whose image is frozen for N frames (default off)')
+    parser.add_argument('--work', default='fuzz_work', help='Working directory (default fuzz_work)')
+    parser.add_argument('--timeout', type=int, default=300, help='Seconds before a run is killed (default 300)')
+    parser.add_argument('--no-minimize', action='store_true', help='Save failing schedules without shrinking them')
+    parser.add_argument('--sim-arg', action='append', default=[], help='Extra simulator option (repeatable)')
+    args = parser.parse_args()
+
+    args.host = args.host or find_host()
+    if not args.host or not os.path.exists(args.host):
+        print('fuzz: no simulator host found; build the design with run_simulation.sh or pass --host', file=sys.stderr)
+        return 1
+    if not os.path.exists(args.design):
+        print('fuzz: %s not found; build it with run_simulation.sh' % args.design, file=sys.stderr)
+        return 1
+
+    fuzzer = Fuzzer(args)
+    rng = random.Random(args.seed)
+    corpus = []                 # Runs that reached frames no earlier run produced
+    coverage = set()
+    runs, failures = [], {}     # signature -> first failing run
+    next_seed = args.seed
+
+    def new_run():
+        nonlocal next_seed
+        seed, next_seed = next_seed, next_seed + 1
+        schedule_rng = random.Random(seed)
+        if args.strategy == 'coverage' and corpus and rng.random() < 0.6:
+            parent = rng.choice(corpus)
+            return Run(seed, mutate_schedule(schedule_rng, parent.presses, args.frames, fuzzer.buttons), parent.seed)
+        return Run(seed, random_schedule(schedule_rng, args.frames, fuzzer.buttons))
+
+    print('[Fuzz] %d runs of %d frames on %d workers, %s strategy' % (args.runs, args.frames, args.jobs, args.strategy),
+          flush=True)
+    with concurrent.futures.ThreadPoolExecutor(max_workers=max(1, args.jobs)) as pool:
+        pending = set()
+        while len(runs) < args.runs or pending:
+            while len(pending) < args.jobs and len(runs) + len(pending) < args.runs:
+                run = new_run()
+                pending.add(pool.submit(fuzzer.execute, run, 'run-%d' % run.seed))
+            done, pending = concurrent.futures.wait(pending, return_when=concurrent.futures.FIRST_COMPLETED)
+            for future in done:
+                run = future.result()
+                runs.append(run)
+                new_frames = len(run.hashes - coverage)
+                coverage |= run.hashes
+                if new_frames and not run.failed():
+                    corpus.append(run)
+                if run.failed() and run.signature() not in failures:
+                    failures[run.signature()] = run
+                    print('[Fuzz] seed %d: %s after %d frames' % (run.seed, run.status, run.frames), flush=True)
+                    for text in run.diagnostic[:2]:
+                        print('[Fuzz]   ' + text, flush=True)
+
+        saved = []
+        for index, run in enumerate(sorted(failures.values(), key=lambda r: r.seed), 1):
+            if args.no_minimize:
+                presses, frames = run.presses, args.frames
+            else:
+                print('[Fuzz] Shrinking seed %d (%d presses)...' % (run.seed, len(run.presses)), flush=True)
+                presses, frames = fuzzer.minimize(run, pool)
+            path = fuzzer.save_failure(run, presses, frames, index)
+            saved.append({'seed': run.seed, 'status': run.status, 'frames': run.frames,
+                          'diagnostic': run.diagnostic[:3], 'presses': len(run.presses),
+                          'minimal_presses': len(presses), 'script': path})
+
+    failed_runs = sum(1 for r in runs if r.failed())
+    print()
+    print('Fuzzing: %d runs, %d failed, %d distinct failures, %d distinct frames, corpus %d' %
+          (len(runs), failed_runs, len(saved), len(coverage), len(corpus)))
+    for s in saved:
+        print('  %-18s seed %-6d %3d -> %2d presses  %s' % (s['status'], s['seed'], s['presses'],
+                                                         s['minimal_presses'], s['script']))
+    with open(os.path.join(args.work, 'report.json'), 'w', encoding='utf-8') as f:
+        json.dump({'runs': len(runs), 'failed_runs': failed_runs, 'frames': args.frames,
+                   'distinct_frames': len(coverage), 'corpus': len(corpus), 'failures': saved}, f, indent=2)
+    return 1 if saved else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,477 @@
+#!/usr/bin/env python3
+"""Build and run many student designs in parallel and collect one report.
+
+For every RTL directory the farm picks the top module, maps its ports to the
+board the way the GUI does and writes DevelopmentBoard.v from the GUI template.
+The designs are verilated and built into plugins on a bounded compile pool
+that shares one simulator host and one copy of the Verilator runtime. Each
+plugin then runs headless with the same stimulus on a work-stealing pool
+sized to the core count. Frame hashes, the simulated clock rate, sync timing
+violations and build errors all end up in one report.
+
+Usage:
+    python3 grade_farm.py RTL_DIR... [--list FILE] [--work DIR] [--frames N]
+                          [--input-script FILE] [--reference RTL_DIR]
+                          [--build-jobs N] [--jobs N] [--timeout SEC]
+                          [--sim-arg ARG ...] [--report-json FILE]
+"""
+import argparse
+import collections
+import concurrent.futures
+import glob
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import threading
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+TEMPLATE_PATH = os.path.join(SCRIPT_DIR, '..', 'gui', 'assets', 'templates', 'development_board.v.tpl')
+
+# Used when the GUI template is not next to this script
+FALLBACK_TEMPLATE = """`timescale 1ns / 1ns
+
+module DevelopmentBoard(
+    input wire clk,  // 50MHz
+    input wire reset, B2, B3, B4, B5,
+    output wire h_sync, v_sync,
+    output wire [15:0] rgb,
+    output wire led1,
+    output wire led2,
+    output wire led3,
+    output wire led4,
+    output wire led5
+);
+
+{{module_name}} {{module_name}}_inst(
+{{connections}}
+);
+
+endmodule
+"""
+
+# Board signal -> port names tried in order; same rules as the GUI's autoInferMapping()
+MAPPING_RULES = collections.OrderedDict([
+    ('clk', ['clk', 'sys_clk', 'clock', 'sys_clock']),
+    ('reset', ['reset', 'sys_rst_n', 'rst_n', 'rst', 'sys_reset']),
+    ('B2', ['up', 'b2', 'btn2']),
+    ('B3', ['down', 'b3', 'btn3']),
+    ('B4', ['left', 'b4', 'btn4']),
+    ('B5', ['right', 'b5', 'btn5']),
+    ('h_sync', ['h_sync', 'hsync', 'hs']),
+    ('v_sync', ['v_sync', 'vsync', 'vs']),
+    ('rgb', ['rgb', 'vga_rgb', 'data']),
+    ('led1', ['led1']),
+    ('led2', ['led2']),
+    ('led3', ['led3']),
+    ('led4', ['led4']),
+    ('led5', ['led5']),
+])
+REQUIRED_SIGNALS = ('clk', 'h_sync', 'v_sync', 'rgb')
+
+# Simulator exit codes (see simulator.cpp)
+EXIT_CODES = {0: 'ok', 1: 'startup failure', 2: 'bad option', 3: 'no h_sync', 4: 'no v_sync', 5: 'frozen image',
+              6: 'diverged from reference', 7: 'invariant failed'}
+
+VERILATOR_FLAGS = ['-O3', '--Wno-fatal', '--cc', '--exe', '-CFLAGS', '-fPIC', '-LDFLAGS', '-shared',
+                   '-o', 'libdesign.so']
+
+
+def strip_comments(text):
+    text = re.sub(r'/\*.*?\*/', '', text, flags=re.S)
+    return re.sub(r'//[^\n]*', '', text)
+
+
+def scan_modules(rtl_dir):
+    """module name -> (port names, names of the modules it instantiates)"""
+    modules = {}
+    for path in sorted(glob.glob(os.path.join(rtl_dir, '*.v')) + glob.glob(os.path.join(rtl_dir, '*.sv'))):
+        try:
+            with open(path, encoding='utf-8', errors='replace') as f:
+                code = strip_comments(f.read())
+        except OSError:
+            continue
+        for m in re.finditer(r'\bmodule\s+(\w+)\s*(?:#\s*\((?:[^()]|\([^()]*\))*\))?\s*\(([^)]*)\)(.*?)\bendmodule\b',
+                             code, flags=re.S):
+            ports = []
+            for decl in m.group(2).split(','):
+                words = re.sub(r'\[[^\]]*\]', ' ', decl).split()
+                if words and re.match(r'^[A-Za-z_]\w*$', words[-1]):
+                    ports.append(words[-1])
+            used = set(re.findall(r'\b([A-Za-z_]\w*)\s*(?:#\s*\(.*?\)\s*)?[A-Za-z_]\w*\s*\(', m.group(3), flags=re.S))
+            modules[m.group(1)] = (ports, used)
+    return modules
+
+
+def pick_top(modules, wanted):
+    """The requested module, or the uninstantiated one that maps the most board signals"""
+    if wanted:
+        return wanted if wanted in modules else None
+    instantiated = set(u for _, used in modules.values() for u in used)
+    candidates = [name for name in modules if name not in instantiated] or list(modules)
+    if not candidates:
+        return None
+    return max(candidates, key=lambda name: (len(infer_mapping(modules[name][0])), name))
+
+
+def infer_mapping(ports):
+    mapping = collections.OrderedDict()
+    for signal, candidates in MAPPING_RULES.items():
+        for candidate in candidates:
+            if candidate in ports:
+                mapping[signal] = candidate
+                break
+    return mapping
+
+
+def write_board(path, module, mapping):
+    template = FALLBACK_TEMPLATE
+    if os.path.exists(TEMPLATE_PATH):
+        with open(TEMPLATE_PATH, encoding='utf-8') as f:
+            template = f.read()
+    connections = ',\n'.join('    .%s(%s)' % (port, signal) for signal, port in mapping.items())
+    with open(path, 'w', encoding='utf-8') as f:
+        f.write(template.replace('{{module_name}}', module).replace('{{connections}}', connections))
+
+
+def error_excerpt(output, limit=5):
+    lines = [l for l in output.splitlines() if '%Error' in l or 'error:' in l or 'Error' in l]
+    return '\n'.join((lines or output.splitlines()[-limit:])[:limit])
+
+
+class Design:
+    def __init__(self, name, rtl_dir, work_dir):
+        self.name = name
+        self.rtl_dir = rtl_dir
+        self.work_dir = work_dir
+        self.top = None
+        self.mapping = {}
+        self.plugin = None
+        self.build_error = None
+        self.status = 'not run'
+        self.exit_code = None
+        self.mhz = None
+        self.frames = 0
+        self.hashes = {}                # frame -> hash
+        self.last_hash = None
+        self.timing_reports = 0
+        self.timing_violations = 0
+        self.timing_problems = []
+        self.diagnostic = []
+        self.reference_match = None
+
+    def to_dict(self):
+        return {
+            'name': self.name, 'rtl_dir': self.rtl_dir, 'top': self.top, 'mapping': self.mapping,
+            'build_error': self.build_error, 'status': self.status, 'exit_code': self.exit_code,
+            'sim_mhz': self.mhz, 'frames': self.frames, 'last_hash': self.last_hash,
+            'hashes': dict((str(k), v) for k, v in sorted(self.hashes.items())),
+            'timing_reports': self.timing_reports, 'timing_violations': self.timing_violations,
+            'timing_problems': self.timing_problems, 'diagnostic': self.diagnostic,
+            'reference_match': self.reference_match,
+        }
+
+
+class Farm:
+    def __init__(self, args):
+        self.args = args
+        self.cxx = os.environ.get('CXX', 'c++')
+        self.runtime_dir = os.path.join(args.work, '_runtime')
+        self.runtime_lock = threading.Lock()
+        self.host = os.path.join(args.work, 'vga_host')
+        self.print_lock = threading.Lock()
+
+    def log(self, message):
+        with self.print_lock:
+            print(message, flush=True)
+
+    def build_host(self):
+        """One host for every design; only the plugins differ"""
+        cflags, libs = ['-I/usr/include/SDL2', '-D_REENTRANT'], ['-lSDL2']
+        if shutil.which('sdl2-config'):
+            cflags = subprocess.run(['sdl2-config', '--cflags'], capture_output=True, text=True).stdout.split()
+            libs = subprocess.run(['sdl2-config', '--libs'], capture_output=True, text=True).stdout.split()
+        cmd = ([self.cxx, '-std=c++11', '-O2', '-pthread'] + cflags +
+               [os.path.join(SCRIPT_DIR, 'simulator.cpp'), '-o', self.host] + libs + ['-ldl'])
+        result = subprocess.run(cmd, capture_output=True, text=True)
+        if result.returncode != 0:
+            print(result.stdout + result.stderr, file=sys.stderr)
+            return False
+        return True
+
+    def build(self, design):
+        """Generate DevelopmentBoard.v and build the design plugin (compile pool)"""
+        modules = scan_modules(design.rtl_dir)
+        design.top = pick_top(modules, self.args.top)
+        if not design.top:
+            design.build_error = 'no usable top module found in %s' % design.rtl_dir
+            return design
+        design.mapping = infer_mapping(modules[design.top][0])
+        missing = [s for s in REQUIRED_SIGNALS if s not in design.mapping]
+        if missing:
+            design.build_error = 'cannot map %s to ports of %s' % (', '.join(missing), design.top)
+            return design
+
+        os.makedirs(design.work_dir, exist_ok=True)
+        obj_dir = os.path.join(design.work_dir, 'obj_dir')
+        shutil.rmtree(obj_dir, ignore_errors=True)
+        write_board(os.path.join(design.work_dir, 'DevelopmentBoard.v'), design.top, design.mapping)
+        for name in ('design_plugin.cpp', 'design_plugin.h'):
+            shutil.copy2(os.path.join(SCRIPT_DIR, name), design.work_dir)
+
+        log = []
+        cmd = (['verilator'] + VERILATOR_FLAGS +
+               ['-I' + os.path.abspath(design.rtl_dir), 'design_plugin.cpp', 'DevelopmentBoard.v'])
+        result = subprocess.run(cmd, cwd=design.work_dir, capture_output=True, text=True)
+        log.append(result.stdout + result.stderr)
+        if result.returncode == 0 and os.path.exists(os.path.join(obj_dir, 'VDevelopmentBoard.mk')):
+            # Runtime objects from an earlier build keep their time stamps, so make skips them
+            with self.runtime_lock:
+                have_runtime = os.path.isdir(self.runtime_dir)
+                if have_runtime:
+                    for path in glob.glob(os.path.join(self.runtime_dir, '*')):
+                        shutil.copy2(path, obj_dir)
+            result = subprocess.run(['make', '-C', 'obj_dir', '-f', 'VDevelopmentBoard.mk'],
+                                    cwd=design.work_dir, capture_output=True, text=True)
+            log.append(result.stdout + result.stderr)
+            if result.returncode == 0 and not have_runtime:
+                self.save_runtime(obj_dir)
+        with open(os.path.join(design.work_dir, 'build.log'), 'w', encoding='utf-8') as f:
+            f.write('\n'.join(log))
+
+        plugin = os.path.join(obj_dir, 'libdesign.so')
+        if result.returncode != 0 or not os.path.exists(plugin):
+            design.build_error = error_excerpt(log[-1]) or 'build failed'
+        else:
+            design.plugin = plugin
+        return design
+
+    def save_runtime(self, obj_dir):
+        files = glob.glob(os.path.join(obj_dir, 'verilated*.o')) + glob.glob(os.path.join(obj_dir, 'verilated*.d'))
+        files += glob.glob(os.path.join(obj_dir, 'libverilated.a'))
+        if not files:
+            return
+        with self.runtime_lock:
+            if os.path.isdir(self.runtime_dir):
+                return
+            tmp = self.runtime_dir + '.tmp'
+            shutil.rmtree(tmp, ignore_errors=True)
+            os.makedirs(tmp)
+            for path in files:
+                shutil.copy2(path, tmp)
+            os.rename(tmp, self.runtime_dir)
+
+    def run(self, design):
+        """Run one plugin headless with the farm's stimulus (run pool)"""
+        cmd = [os.path.abspath(self.host), '--design=' + os.path.abspath(design.plugin), '--headless',
+               '--frames=%d' % self.args.frames, '--hash-every=%d' % self.args.hash_every,
+               '--timing-report=%d' % self.args.timing_report]
+        if self.args.input_script:
+            cmd.append('--input-script=' + os.path.abspath(self.args.input_script))
+        cmd += self.args.sim_arg
+        try:
+            result = subprocess.run(cmd, cwd=design.work_dir, capture_output=True, text=True,
+                                    timeout=self.args.timeout)
+            output, design.exit_code = result.stdout + result.stderr, result.returncode
+            design.status = EXIT_CODES.get(result.returncode, 'exit code %d' % result.returncode)
+        except subprocess.TimeoutExpired as e:
+            output = (e.stdout or b'').decode(errors='replace') + (e.stderr or b'').decode(errors='replace')
+            design.status = 'timeout after %d s' % self.args.timeout
+        with open(os.path.join(design.work_dir, 'run.log'), 'w', encoding='utf-8') as f:
+            f.write(output)
+        parse_run_output(design, output)
+        return design
+
+
+def parse_run_output(design, output):
+    problems = []
+    for text in output.splitlines():
+        m = re.match(r'^\[Hash\] Frame (\d+) ([0-9a-f]+)', text)
+        if m:
+            design.hashes[int(m.group(1))] = m.group(2)
+            design.frames = max(design.frames, int(m.group(1)))
+            continue
+        m = re.match(r'^\[Batch\] (\d+) frames done, last frame hash ([0-9a-f]+)', text)
+        if m:
+            design.frames, design.last_hash = int(m.group(1)), m.group(2)
+            continue
+        m = re.match(r'^Simulated clock:\s*([0-9.]+) MHz', text)
+        if m:
+            design.mhz = float(m.group(1))
+            continue
+        if text.startswith('[Timing] Frames'):
+            design.timing_reports += 1
+            design.timing_violations += 'violation' in text
+        elif text.startswith('[Timing]   ') and text.strip() not in problems:
+            problems.append(text[len('[Timing]'):].strip())
+        elif text.startswith('[Watchdog]'):
+            design.diagnostic.append(text)
+            m = re.search(r'Stopped after (\d+) frames.*last frame hash ([0-9a-f]+)', text)
+            if m:
+                design.frames, design.last_hash = int(m.group(1)), m.group(2)
+    design.timing_problems = problems[:5]
+
+
+class WorkStealingPool:
+    """Fixed set of worker threads, each with its own deque of tasks.
+
+    New tasks are dealt round-robin. A worker takes from the front of its own
+    deque and, when that is empty, steals from the back of another worker's,
+    so a few slow or hanging designs never leave the other cores idle.
+    """
+
+    def __init__(self, workers, func):
+        self.func = func
+        self.deques = [collections.deque() for _ in range(workers)]
+        self.cond = threading.Condition()
+        self.closed = False
+        self.dealt = 0
+        self.steals = 0
+        self.threads = [threading.Thread(target=self.worker, args=(i,), daemon=True) for i in range(workers)]
+        for t in self.threads:
+            t.start()
+
+    def submit(self, task):
+        with self.cond:
+            self.deques[self.dealt % len(self.deques)].append(task)
+            self.dealt += 1
+            self.cond.notify_all()
+
+    def close_and_join(self):
+        with self.cond:
+            self.closed = True
+            self.cond.notify_all()
+        for t in self.threads:
+            t.join()
+
+    def take(self, index):
+        with self.cond:
+            while True:
+                if self.deques[index]:
+                    return self.deques[index].popleft()
+                for k in range(1, len(self.deques)):
+                    victim = self.deques[(index + k) % len(self.deques)]
+                    if victim:
+                        self.steals += 1
+                        return victim.pop()
+                if self.closed:
+                    return None
+                self.cond.wait()
+
+    def worker(self, index):
+        while True:
+            task = self.take(index)
+            if task is None:
+                return
+            self.func(task)
+
+
+def format_report(designs):
+    out = ['%-20s %-24s %8s %7s %-18s %-10s %s' % ('Design', 'Result', 'MHz', 'Frames', 'Timing', 'Reference', 'Last hash')]
+    for d in designs:
+        if d.build_error:
+            first = d.build_error.splitlines()[0] if d.build_error else ''
+            out.append('%-20s %-24s %s' % (d.name, 'BUILD FAILED', first))
+            continue
+        if d.timing_reports == 0:
+            timing = '-'
+        elif d.timing_violations:
+            timing = '%d/%d reports bad' % (d.timing_violations, d.timing_reports)
+        else:
+            timing = 'OK'
+        ref = '-' if d.reference_match is None else '%d/%d' % tuple(d.reference_match)
+        mhz = '%.2f' % d.mhz if d.mhz is not None else '-'
+        out.append('%-20s %-24s %8s %7d %-18s %-10s %s' % (d.name, d.status, mhz, d.frames, timing, ref,
+                                                         d.last_hash or '-'))
+        for problem in d.timing_problems[:2]:
+            out.append('%-20s   timing: %s' % ('', problem))
+    return '\n'.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build and grade many VGA designs in parallel.')
+    parser.add_argument('rtl_dirs', nargs='*', help='RTL directories, one per submission')
+    parser.add_argument('--list', help='File with one RTL directory per line')
+    parser.add_argument('--top', help='Top module name (default: detected per submission)')
+    parser.add_argument('--reference', help='RTL directory of the reference solution to compare frame hashes with')
+    parser.add_argument('--work', default='grade_farm_work', help='Working directory (default grade_farm_work)')
+    parser.add_argument('--frames', type=int, default=120, help='Frames to simulate per design (default 120)')
+    parser.add_argument('--hash-every', type=int, default=10, help='Record the frame hash every N frames (default 10)')
+    parser.add_argument('--timing-report', type=int, default=60, help='Sync timing report interval in frames (default 60)')
+    parser.add_argument('--input-script', help='Button script passed to every run (see --input-script in the simulator)')
+    parser.add_argument('--sim-arg', action='append', default=[], help='Extra simulator option (repeatable)')
+    parser.add_argument('--build-jobs', type=int, default=max(1, (os.cpu_count() or 2) // 2),
+                        help='Designs built at the same time (default: half the cores)')
+    parser.add_argument('--jobs', type=int, default=os.cpu_count() or 1,
+                        help='Designs simulated at the same time (default: all cores)')
+    parser.add_argument('--timeout', type=int, default=600, help='Seconds before a run is killed (default 600)')
+    parser.add_argument('--report-json', help='Report file (default WORK/report.json)')
+    args = parser.parse_args()
+
+    rtl_dirs = list(args.rtl_dirs)
+    if args.list:
+        with open(args.list, encoding='utf-8') as f:
+            rtl_dirs += [l.strip() for l in f if l.strip() and not l.startswith('#')]
+    if args.reference:
+        rtl_dirs.insert(0, args.reference)
+    if not rtl_dirs:
+        parser.error('no RTL directories given')
+    for tool in ('verilator', 'make'):
+        if not shutil.which(tool):
+            print('grade_farm: %s not found' % tool, file=sys.stderr)
+            return 1
+
+    os.makedirs(args.work, exist_ok=True)
+    designs, names = [], set()
+    for i, rtl_dir in enumerate(rtl_dirs):
+        base = re.sub(r'\W', '_', os.path.basename(os.path.normpath(os.path.abspath(rtl_dir)))) or 'design'
+        if args.reference and i == 0:
+            base = 'reference'
+        name, n = base, 2
+        while name in names:
+            name, n = '%s_%d' % (base, n), n + 1
+        names.add(name)
+        designs.append(Design(name, rtl_dir, os.path.join(args.work, name)))
+
+    farm = Farm(args)
+    farm.log('[Farm] Building the simulator host...')
+    if not farm.build_host():
+        print('grade_farm: building the simulator host failed', file=sys.stderr)
+        return 1
+
+    def run_one(design):
+        farm.run(design)
+        farm.log('[Farm] %-20s %s' % (design.name, design.status))
+
+    farm.log('[Farm] %d designs: %d build jobs, %d run workers' % (len(designs), args.build_jobs, args.jobs))
+    pool = WorkStealingPool(max(1, args.jobs), run_one)
+    with concurrent.futures.ThreadPoolExecutor(max_workers=max(1, args.build_jobs)) as builders:
+        futures = [builders.submit(farm.build, d) for d in designs]
+        for future in concurrent.futures.as_completed(futures):
+            design = future.result()
+            if design.plugin:
+                pool.submit(design)     # Start simulating while the others still build
+            else:
+                farm.log('[Farm] %-20s build failed' % design.name)
+    pool.close_and_join()
+
+    if args.reference and designs[0].hashes:
+        ref = designs[0].hashes
+        for d in designs:
+            if not d.build_error:
+                d.reference_match = [sum(1 for f, h in ref.items() if d.hashes.get(f) == h), len(ref)]
+
+    print()
+    print(format_report(designs))
+    report_path = args.report_json or os.path.join(args.work, 'report.json')
+    with open(report_path, 'w', encoding='utf-8') as f:
+        json.dump({'frames': args.frames, 'input_script': args.input_script, 'steals': pool.steals,
+                   'designs': [d.to_dict() for d in designs]}, f, indent=2)
+    print('\nReport: %s (logs in %s/<design>/)' % (report_path, args.work))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+"""Performance lint for the RTL being simulated.
+
+run_simulation.sh verilates with --Wno-fatal, so warnings about constructs that
+make eval() slow scroll past unnoticed. This script reads Verilator's output
+(and optionally its --stats report and the RTL sources) and prints a ranked
+list of the constructs most likely to cost simulation speed, with file and line.
+
+Usage:
+    python3 perf_lint.py VERILATOR_LOG [--stats FILE] [--rtl DIR ...]
+                         [--top N] [--output FILE] [--json FILE]
+"""
+import argparse
+import json
+import os
+import re
+import sys
+
+# Warning code -> (base score, what it means, what to do about it)
+WARNING_COSTS = {
+    'UNOPTFLAT': (100, 'Circular combinational logic',
+                  'eval() re-runs the loop until it settles; split the vector into separate '
+                  'signals or add /*verilator split_var*/ to the declaration'),
+    'UNOPT': (90, 'Combinational logic Verilator cannot order',
+              'eval() re-runs the block until it settles; break the dependency loop'),
+    'MULTIDRIVEN': (60, 'Signal driven from several always blocks',
+                    'the blocks cannot be scheduled as one process; drive each signal '
+                    'from a single always block'),
+    'ALWCOMBORDER': (40, 'Combinational block reads a variable before assigning it',
+                     'reorder the assignments so every value is computed before it is used'),
+    'LATCH': (30, 'Combinational block infers a latch',
+              'assign every output on every path (add a default) so the block stays combinational'),
+    'IMPERFECTSCH': (30, 'Imperfect scheduling of a variable',
+                     'usually a clock derived from logic; use a clock enable instead of a divided clock'),
+    'COMBDLY': (20, 'Non-blocking assignment in combinational logic',
+                'use blocking assignments (=) in always @(*) blocks'),
+    'UNOPTTHREADS': (10, 'Design could not be split into threads',
+                     'only matters for multi-threaded builds'),
+}
+
+CASE_ITEMS_THRESHOLD = 64     # Case statements with at least this many items are reported
+
+WARNING_RE = re.compile(r'^%Warning-(\w+):\s*([^:\s]+):(\d+):(?:\d+:)?\s*(.*)$')
+SIGNAL_RE = re.compile(r"'([^']+)'")
+CASE_ITEM_RE = re.compile(r"^\s*([\w'\s,{}\[\]+\-]+?)\s*:(?!=)")
+
+
+class Finding:
+    def __init__(self, score, code, title, advice, path, line, detail=''):
+        self.score = score
+        self.code = code
+        self.title = title
+        self.advice = advice
+        self.path = path
+        self.line = line
+        self.detail = detail
+        self.count = 1
+
+    def location(self):
+        return '%s:%d' % (self.path, self.line) if self.path else '-'
+
+    def to_dict(self):
+        return {
+            'score': self.score, 'code': self.code, 'title': self.title,
+            'file': self.path, 'line': self.line, 'detail': self.detail,
+            'count': self.count, 'advice': self.advice,
+        }
+
+
+def strip_comments(text):
+    """Blank out // and /* */ comments, keeping line numbers intact"""
+    text = re.sub(r'/\*.*?\*/', lambda m: '\n' * m.group(0).count('\n'), text, flags=re.S)
+    return re.sub(r'//[^\n]*', '', text)
+
+
+def read_source(path, cache):
+    if path not in cache:
+        try:
+            with open(path, encoding='utf-8', errors='replace') as f:
+                cache[path] = strip_comments(f.read()).split('\n')
+        except OSError:
+            cache[path] = None
+    return cache[path]
+
+
+def signal_width(lines, name):
+    """Width of the vector `name` declared in `lines`, or 1 if it is not found"""
+    decl = re.compile(r'\[\s*(\d+)\s*:\s*(\d+)\s*\][^;=\[]*\b' + re.escape(name) + r'\b')
+    for text in lines or []:
+        m = decl.search(text)
+        if m and re.search(r'\b(wire|reg|logic|input|output|inout)\b', text):
+            return abs(int(m.group(1)) - int(m.group(2))) + 1
+    return 1
+
+
+def parse_warnings(log_lines, sources):
+    """Findings from Verilator warnings; repeats of the same warning are merged"""
+    findings = {}
+    for text in log_lines:
+        m = WARNING_RE.match(text)
+        if not m:
+            continue
+        code, path, line, message = m.group(1), m.group(2), int(m.group(3)), m.group(4)
+        if code not in WARNING_COSTS:
+            continue
+        key = (code, path, line)
+        if key in findings:
+            findings[key].count += 1
+            continue
+        score, title, advice = WARNING_COSTS[code]
+        detail = ''
+        signal = SIGNAL_RE.search(message)
+        if signal:
+            name = signal.group(1).split('.')[-1]
+            detail = "signal '%s'" % name
+            if code in ('MULTIDRIVEN', 'UNOPTFLAT'):
+                # Wide vectors are re-evaluated as a whole; weigh them by width
+                width = signal_width(read_source(path, sources), name)
+                if width > 1:
+                    detail += ', %d bits' % width
+                    score += min(width, 64)
+        findings[key] = Finding(score, code, title, advice, path, line, detail)
+    return list(findings.values())
+
+
+def find_large_cases(path, lines, threshold):
+    """Case statements with at least `threshold` items in one source file"""
+    findings = []
+    stack = []      # [start line, item count] per open case statement
+    for number, text in enumerate(lines, 1):
+        for word in re.findall(r'\b(casez|casex|case|endcase)\b', text):
+            if word == 'endcase':
+                if stack:
+                    start, items = stack.pop()
+                    if items >= threshold:
+                        findings.append(Finding(
+                            min(80, 10 + items // 4), 'LARGECASE', 'Large case statement',
+                            'every evaluation of the block walks the whole decode; use a lookup '
+                            'table (a memory indexed by the selector) or split the case',
+                            path, start, '%d items' % items))
+            else:
+                stack.append([number, 0])
+        if stack and not re.search(r'\b(case[zx]?)\b', text):
+            m = CASE_ITEM_RE.match(text)
+            if m and m.group(1).strip() not in ('default', 'begin', 'end'):
+                stack[-1][1] += 1
+    return findings
+
+
+def scan_rtl(dirs, sources, threshold):
+    findings = []
+    for top in dirs:
+        for root, _, files in os.walk(top):
+            for name in sorted(files):
+                if name.endswith(('.v', '.sv', '.vh', '.svh')):
+                    path = os.path.join(root, name)
+                    lines = read_source(path, sources)
+                    if lines:
+                        findings.extend(find_large_cases(path, lines, threshold))
+    return findings
+
+
+def parse_stats(path):
+    """Model size figures from Verilator's --stats report (last column = final stage)"""
+    wanted = ('Instruction count, TOTAL', 'Instruction count, fast critical',
+              'Var space, non-arrays, bytes', 'Var space, scoped, bytes')
+    stats = {}
+    try:
+        with open(path, encoding='utf-8', errors='replace') as f:
+            for text in f:
+                label = text.strip()
+                for name in wanted:
+                    if label.startswith(name):
+                        numbers = re.findall(r'\d+', label[len(name):])
+                        if numbers:
+                            stats[name] = int(numbers[-1])
+    except OSError:
+        pass
+    return stats
+
+
+def format_report(findings, stats, top):
+    out = []
+    if not findings:
+        out.append('Performance lint: no slow constructs found')
+    else:
+        shown = findings if top <= 0 else findings[:top]
+        out.append('Performance lint: %d finding(s), most expensive first' % len(findings))
+        out.append('  %3s  %5s  %-12s %s' % ('#', 'Score', 'Check', 'Location'))
+        for i, f in enumerate(shown, 1):
+            where = f.location()
+            if f.detail:
+                where += ' (%s)' % f.detail
+            if f.count > 1:
+                where += ' x%d' % f.count
+            out.append('  %3d  %5d  %-12s %s' % (i, f.score, f.code, where))
+            out.append('                         %s: %s' % (f.title, f.advice))
+        if len(shown) < len(findings):
+            out.append('  ... %d more' % (len(findings) - len(shown)))
+    if stats:
+        out.append('Model size: ' + ', '.join('%s %d' % (k, v) for k, v in stats.items()))
+    return '\n'.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Rank RTL constructs that slow down Verilator simulation.')
+    parser.add_argument('log', help='Verilator output (warnings) to analyse')
+    parser.add_argument('--stats', help="Verilator's --stats report (obj_dir/V<top>__stats.txt)")
+    parser.add_argument('--rtl', action='append', default=[], help='RTL directory to scan for large case statements')
+    parser.add_argument('--top', type=int, default=10, help='Findings to print (default 10, 0 = all)')
+    parser.add_argument('--output', help='Also write the full report to this file')
+    parser.add_argument('--json', help='Also write the findings as JSON to this file')
+    args = parser.parse_args()
+
+    try:
+        with open(args.log, encoding='utf-8', errors='replace') as f:
+            log_lines = f.read().splitlines()
+    except OSError as e:
+        print('perf_lint: %s' % e, file=sys.stderr)
+        return 1
+
+    sources = {}
+    findings = parse_warnings(log_lines, sources)
+    findings.extend(scan_rtl(args.rtl, sources, CASE_ITEMS_THRESHOLD))
+    findings.sort(key=lambda f: (-f.score, f.path, f.line))
+    stats = parse_stats(args.stats) if args.stats else {}
+
+    print(format_report(findings, stats, args.top))
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            f.write(format_report(findings, stats, 0) + '\n')
+    if args.json:
+        with open(args.json, 'w', encoding='utf-8') as f:
+            json.dump({'findings': [x.to_dict() for x in findings], 'stats': stats}, f, indent=2)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,304 @@
+// Python bindings for the headless simulator: `import pyvga`.
+//
+// Built by run_simulation.sh --python into obj_dir/pyvga<EXT_SUFFIX>. The
+// simulator host is compiled into the module (simulator.cpp without main()),
+// so a design plugin runs exactly as under --headless: same reset, mode
+// detection, sampler and frame hashes. Only one Simulator can exist per
+// process because the host keeps its state in globals.
+//
+//     sim = pyvga.Simulator("obj_dir/design.so")
+//     sim.set_buttons(B2=True)        # pressed = signal low
+//     sim.run_frames(10)
+//     img = sim.frame                 # numpy uint16 (height, width) RGB565, no copy
+//     sim.leds                        # (led1, ..., led5)
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define VGA_SIM_NO_MAIN
+#include "simulator.cpp"
+
+struct PySimulator {
+    PyObject_HEAD
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+    bool owner;                     // This object loaded the design (zeroed by tp_new)
+};
+static bool g_py_instance = false;
+static std::vector<std::string> g_py_argv;  // Backing storage of g_design_args
+
+static int sim_init(PySimulator* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = {"design", "mode", "plusargs", nullptr};
+    const char* design = "obj_dir/design.so";
+    const char* mode = nullptr;
+    PyObject* plusargs = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|szO", (char**)kwlist, &design, &mode, &plusargs)) {
+        return -1;
+    }
+    if (g_py_instance) {
+        PyErr_SetString(PyExc_RuntimeError, "only one pyvga.Simulator can exist per process");
+        return -1;
+    }
+    g_options.headless = true;
+    g_options.timing_report = 0;
+    g_options.watchdog_ms = 0;
+    g_options.timing_mode = -1;
+    if (mode) {
+        for (int m = 0; m < NUM_VESA_MODES; m++) {
+            if (strcmp(mode, VESA_MODES[m].name) == 0) g_options.timing_mode = m;
+        }
+        if (g_options.timing_mode < 0) {
+            PyErr_Format(PyExc_ValueError, "unknown VGA mode '%s'", mode);
+            return -1;
+        }
+    }
+
+    // argv for the plugin: +verilator+ plusargs, e.g. ["+verilator+seed+5"]
+    g_py_argv.assign(1, "pyvga");
+    if (plusargs) {
+        PyObject* seq = PySequence_Fast(plusargs, "plusargs must be a sequence of strings");
+        if (!seq) return -1;
+        for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+            const char* arg = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, i));
+            if (!arg) {
+                Py_DECREF(seq);
+                return -1;
+            }
+            g_py_argv.push_back(arg);
+        }
+        Py_DECREF(seq);
+    }
+    g_design_args.clear();
+    for (std::string& arg : g_py_argv) {
+        g_design_args.push_back(&arg[0]);
+    }
+    g_design_args.push_back(nullptr);
+
+    g_options.design_path = design;
+    std::string error;
+    if (!load_design(g_options.design_path, g_design, error)) {
+        PyErr_Format(PyExc_OSError, "cannot load design plugin %s: %s", design, error.c_str());
+        return -1;
+    }
+    g_py_instance = true;
+    self->owner = true;
+    start_design();
+    return 0;
+}
+
+static void sim_dealloc(PySimulator* self) {
+    if (self->owner) {
+        if (g_design.instance) {
+            unload_design(g_design);
+        }
+        g_py_instance = false;
+    }
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static bool check_open() {
+    if (!g_design.instance) {
+        PyErr_SetString(PyExc_RuntimeError, "the simulator was closed");
+        return false;
+    }
+    return true;
+}
+
+// Evaluate and sample `pixels` pixels in sampler-sized batches
+static void run_and_sample(uint64_t pixels) {
+    static uint32_t batch[SAMPLE_BATCH];
+    while (pixels > 0 && !design_finished()) {
+        int n = (int)std::min<uint64_t>(pixels, SAMPLE_BATCH);
+        run_pixels(batch, n);
+        g_sample_batch(batch, n);
+        pixels -= n;
+    }
+}
+
+static PyObject* sim_reset(PySimulator*, PyObject*) {
+    if (!check_open()) return nullptr;
+    reset();
+    Py_RETURN_NONE;
+}
+
+static PyObject* sim_step(PySimulator*, PyObject* args) {
+    unsigned long long cycles = 1;
+    if (!PyArg_ParseTuple(args, "|K", &cycles)) return nullptr;
+    if (!check_open()) return nullptr;
+    // The model runs in whole pixels; round up to the pixel clock
+    int cpp = g_timing.clocks_per_pixel;
+    run_and_sample((cycles + cpp - 1) / cpp);
+    return PyLong_FromUnsignedLongLong(main_time / 2);
+}
+
+static PyObject* sim_run_frames(PySimulator*, PyObject* args) {
+    unsigned long long frames = 1;
+    if (!PyArg_ParseTuple(args, "|K", &frames)) return nullptr;
+    if (!check_open()) return nullptr;
+    // Stop in the batch with the v_sync edge: the finished frame stays in the
+    // framebuffer until the next frame's active area starts
+    uint64_t target = g_vsync_count + frames;
+    uint64_t limit = (uint64_t)(TOTAL_WIDTH * TOTAL_HEIGHT) * (frames + 2) * 4;
+    static uint32_t batch[SAMPLE_BATCH + 2048];
+    while (g_vsync_count < target && limit > 0 && !design_finished()) {
+        int n = next_batch_size();
+        run_pixels(batch, n);
+        g_sample_batch(batch, n);
+        limit -= std::min<uint64_t>(limit, n);
+    }
+    if (g_vsync_count < target && !design_finished()) {
+        PyErr_SetString(PyExc_RuntimeError, "no v_sync pulse: the design does not produce frames");
+        return nullptr;
+    }
+    return PyLong_FromUnsignedLongLong(g_vsync_count);
+}
+
+static PyObject* sim_set_buttons(PySimulator*, PyObject* args, PyObject* kwargs) {
+    if (PyTuple_GET_SIZE(args) != 0) {
+        PyErr_SetString(PyExc_TypeError, "set_buttons() takes keyword arguments only, e.g. B2=True");
+        return nullptr;
+    }
+    PyObject* key;
+    PyObject* value;
+    Py_ssize_t pos = 0;
+    while (kwargs && PyDict_Next(kwargs, &pos, &key, &value)) {
+        int button = parse_button(PyUnicode_AsUTF8(key));
+        int pressed = PyObject_IsTrue(value);
+        if (button < 0) {
+            PyErr_Format(PyExc_ValueError, "unknown button '%U' (RESET, B2, B3, B4 or B5)", key);
+            return nullptr;
+        }
+        if (pressed < 0) return nullptr;
+        keys[button].store(pressed ? 0 : 1, std::memory_order_relaxed);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* sim_close(PySimulator*, PyObject*) {
+    if (g_design.instance) {
+        unload_design(g_design);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* sim_get_leds(PySimulator*, void*) {
+    return Py_BuildValue("(iiiii)", display->led1, display->led2, display->led3, display->led4, display->led5);
+}
+
+static PyObject* sim_get_frame(PySimulator* self, void*) {
+    PyObject* view = PyMemoryView_FromObject((PyObject*)self);
+    if (!view) return nullptr;
+    PyObject* numpy = PyImport_ImportModule("numpy");
+    if (!numpy) {
+        PyErr_Clear();
+        return view;            // numpy.asarray() of this is still a zero-copy view
+    }
+    PyObject* array = PyObject_CallMethod(numpy, "asarray", "O", view);
+    Py_DECREF(numpy);
+    Py_DECREF(view);
+    return array;
+}
+
+static PyObject* sim_get_frame_count(PySimulator*, void*) {
+    return PyLong_FromUnsignedLongLong(g_vsync_count);
+}
+
+static PyObject* sim_get_frame_hash(PySimulator*, void*) {
+    char hash[24];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)g_last_frame_hash);
+    return PyUnicode_FromString(hash);
+}
+
+static PyObject* sim_get_cycles(PySimulator*, void*) {
+    return PyLong_FromUnsignedLongLong(main_time / 2);
+}
+
+static PyObject* sim_get_mode(PySimulator*, void*) {
+    return PyUnicode_FromString(g_timing.name);
+}
+
+static PyObject* sim_get_finished(PySimulator*, void*) {
+    return PyBool_FromLong(g_design.instance && design_finished());
+}
+
+// Buffer protocol: the framebuffer as a read-only (height, width) uint16 array
+static int sim_getbuffer(PySimulator* self, Py_buffer* view, int flags) {
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "the framebuffer is read-only");
+        return -1;
+    }
+    self->shape[0] = ACTIVE_HEIGHT;
+    self->shape[1] = ACTIVE_WIDTH;
+    self->strides[0] = (Py_ssize_t)ACTIVE_WIDTH * sizeof(uint16_t);
+    self->strides[1] = sizeof(uint16_t);
+    view->buf = write_buffer.load(std::memory_order_relaxed);
+    view->obj = (PyObject*)self;
+    Py_INCREF(self);
+    view->len = self->shape[0] * self->strides[0];
+    view->readonly = 1;
+    view->itemsize = sizeof(uint16_t);
+    view->format = (flags & PyBUF_FORMAT) ? (char*)"H" : nullptr;
+    view->ndim = 2;
+    view->shape = self->shape;
+    view->strides = self->strides;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+static PyMethodDef sim_methods[] = {
+    {"reset", (PyCFunction)sim_reset, METH_NOARGS, "reset()\n\nPulse reset as at startup; buttons return to released."},
+    {"step", (PyCFunction)sim_step, METH_VARARGS,
+     "step(cycles=1) -> int\n\nRun at least `cycles` 50 MHz board clocks (whole pixels); returns the clock count."},
+    {"run_frames", (PyCFunction)sim_run_frames, METH_VARARGS,
+     "run_frames(n=1) -> int\n\nRun until n more frames have finished; returns the frame count."},
+    {"set_buttons", (PyCFunction)(void (*)(void))sim_set_buttons, METH_VARARGS | METH_KEYWORDS,
+     "set_buttons(RESET=None, B2=None, B3=None, B4=None, B5=None)\n\nTrue = pressed (signal low)."},
+    {"close", (PyCFunction)sim_close, METH_NOARGS, "close()\n\nUnload the design."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyGetSetDef sim_getset[] = {
+    {(char*)"frame", (getter)sim_get_frame, nullptr,
+     (char*)"Last finished frame as a (height, width) uint16 RGB565 array viewing the framebuffer", nullptr},
+    {(char*)"leds", (getter)sim_get_leds, nullptr, (char*)"(led1, ..., led5)", nullptr},
+    {(char*)"frame_count", (getter)sim_get_frame_count, nullptr, (char*)"Frames finished so far", nullptr},
+    {(char*)"frame_hash", (getter)sim_get_frame_hash, nullptr, (char*)"Hash of the last finished frame", nullptr},
+    {(char*)"cycles", (getter)sim_get_cycles, nullptr, (char*)"50 MHz board clocks simulated", nullptr},
+    {(char*)"mode", (getter)sim_get_mode, nullptr, (char*)"VGA mode in use", nullptr},
+    {(char*)"finished", (getter)sim_get_finished, nullptr, (char*)"The design executed $finish", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+static PyBufferProcs sim_buffer_procs;
+static PyTypeObject SimulatorType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+static PyModuleDef pyvga_module = {PyModuleDef_HEAD_INIT};
+
+PyMODINIT_FUNC PyInit_pyvga(void) {
+    sim_buffer_procs.bf_getbuffer = (getbufferproc)sim_getbuffer;
+    SimulatorType.tp_name = "pyvga.Simulator";
+    SimulatorType.tp_doc = "Simulator(design='obj_dir/design.so', mode=None, plusargs=())\n\n"
+                           "Load a design plugin built by run_simulation.sh, reset it and detect its VGA mode.";
+    SimulatorType.tp_basicsize = sizeof(PySimulator);
+    SimulatorType.tp_flags = Py_TPFLAGS_DEFAULT;
+    SimulatorType.tp_new = PyType_GenericNew;
+    SimulatorType.tp_init = (initproc)sim_init;
+    SimulatorType.tp_dealloc = (destructor)sim_dealloc;
+    SimulatorType.tp_methods = sim_methods;
+    SimulatorType.tp_getset = sim_getset;
+    SimulatorType.tp_as_buffer = &sim_buffer_procs;
+    if (PyType_Ready(&SimulatorType) < 0) return nullptr;
+
+    pyvga_module.m_name = "pyvga";
+    pyvga_module.m_doc = "Headless VGA simulator for Verilated designs";
+    pyvga_module.m_size = -1;
+    PyObject* module = PyModule_Create(&pyvga_module);
+    if (!module) return nullptr;
+    Py_INCREF(&SimulatorType);
+    if (PyModule_AddObject(module, "Simulator", (PyObject*)&SimulatorType) < 0) {
+        Py_DECREF(&SimulatorType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
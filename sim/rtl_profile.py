@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+"""Per-module and per-always-block time for a --profile run.
+
+The simulator's --profile option writes CPU samples per function. When the
+design was verilated with --prof-cfuncs (run_simulation.sh --profile does
+this), every function Verilator generates is named after the Verilog file and
+line it came from, e.g. _sequent__TOP__1__PROF__vga_pic__l37. This script maps
+those names back to the RTL and reports where the simulation time goes, per
+module instance and per always block / assign statement.
+
+Usage:
+    python3 rtl_profile.py SAMPLES [--rtl DIR ...] [--top N]
+                           [--output FILE] [--json FILE]
+"""
+import argparse
+import bisect
+import json
+import os
+import re
+import subprocess
+import sys
+
+PROF_RE = re.compile(r'__PROF__(\w+)__l(\d+)')
+MODULE_RE = re.compile(r'\bmodule\s+(\w+)')
+STATEMENT_RE = re.compile(r'^\s*(always\w*|assign|initial)\b')
+KEYWORDS = {'module', 'endmodule', 'input', 'output', 'inout', 'wire', 'reg', 'logic',
+            'assign', 'always', 'initial', 'parameter', 'localparam', 'if', 'else',
+            'case', 'begin', 'end', 'function', 'task', 'generate', 'genvar', 'integer'}
+
+
+def strip_comments(text):
+    """Blank out // and /* */ comments, keeping line numbers intact"""
+    text = re.sub(r'/\*.*?\*/', lambda m: '\n' * m.group(0).count('\n'), text, flags=re.S)
+    return re.sub(r'//[^\n]*', '', text)
+
+
+class RtlIndex:
+    """Modules, statements and instances found in the RTL sources"""
+
+    def __init__(self, dirs):
+        self.files = {}         # --prof-cfuncs file name (basename, [^\w] -> _) -> path
+        self.lines = {}         # path -> source lines
+        self.modules = {}       # path -> [(first line, name)]
+        self.statements = {}    # path -> sorted first lines of always/assign/initial
+        self.children = {}      # module -> [(instance, module)]
+        seen = set()
+        for top in dirs:
+            for root, _, names in os.walk(top):
+                for name in sorted(names):
+                    path = os.path.join(root, name)
+                    if name.endswith(('.v', '.sv')) and os.path.realpath(path) not in seen:
+                        seen.add(os.path.realpath(path))
+                        self.add_file(path)
+
+    def add_file(self, path):
+        try:
+            with open(path, encoding='utf-8', errors='replace') as f:
+                raw = f.read()
+        except OSError:
+            return
+        key = re.sub(r'\W', '_', os.path.splitext(os.path.basename(path))[0])
+        self.files.setdefault(key, path)
+        self.lines[path] = raw.split('\n')
+        code = strip_comments(raw)
+        lines = code.split('\n')
+        self.modules[path] = [(n, m.group(1)) for n, text in enumerate(lines, 1)
+                              for m in [MODULE_RE.search(text)] if m]
+        self.statements[path] = [n for n, text in enumerate(lines, 1) if STATEMENT_RE.match(text)]
+        # Instantiations: "type [#(...)] name (" inside a module body
+        for m in re.finditer(r'\bmodule\s+(\w+)(.*?)\bendmodule\b', code, flags=re.S):
+            body = re.sub(r'#\s*\((?:[^()]|\([^()]*\))*\)', ' ', m.group(2))
+            for inst in re.finditer(r'\b([A-Za-z_]\w*)\s+([A-Za-z_]\w*)\s*\(', body):
+                if inst.group(1) not in KEYWORDS and inst.group(2) not in KEYWORDS:
+                    self.children.setdefault(m.group(1), []).append((inst.group(2), inst.group(1)))
+
+    def module_at(self, path, line):
+        names = [name for start, name in self.modules.get(path, []) if start <= line]
+        return names[-1] if names else None
+
+    def statement_at(self, path, line):
+        """First line and text of the always/assign/initial statement containing `line`"""
+        starts = self.statements.get(path, [])
+        i = bisect.bisect_right(starts, line) - 1
+        start = starts[i] if i >= 0 else line
+        text = ' '.join(self.lines[path][start - 1].split()) if path in self.lines else ''
+        return start, text[:60]
+
+    def instances(self, top):
+        """module -> instance paths below `top`"""
+        found = {top: [top]}
+        known = set(name for mods in self.modules.values() for _, name in mods)
+
+        def walk(module, prefix, depth):
+            for inst, child in self.children.get(module, []):
+                if child in known:
+                    found.setdefault(child, []).append(prefix + '.' + inst)
+                    if depth < 32:
+                        walk(child, prefix + '.' + inst, depth + 1)
+        walk(top, top, 0)
+        return found
+
+
+def read_symbols(library):
+    """Sorted (address, name) of the functions in `library`, from nm"""
+    try:
+        out = subprocess.run(['nm', '-n', '-C', library], capture_output=True, text=True).stdout
+    except OSError:
+        return []
+    symbols = []
+    for text in out.splitlines():
+        parts = text.split(None, 2)
+        if len(parts) == 3 and parts[1] in 'tTwW':
+            symbols.append((int(parts[0], 16), parts[2]))
+    return symbols
+
+
+def read_samples(path):
+    header = {}
+    rows = []
+    with open(path, encoding='utf-8', errors='replace') as f:
+        for text in f:
+            if text.startswith('#'):
+                words = text[1:].split()
+                header.update(zip(words[::2], words[1::2]))
+                continue
+            parts = text.rstrip('\n').split('\t', 2)
+            if len(parts) == 3:
+                rows.append((int(parts[0]), parts[1], parts[2]))
+    return header, rows
+
+
+def build_report(header, rows, rtl):
+    symbols = read_symbols(header['design']) if 'design' in header else []
+    addresses = [a for a, _ in symbols]
+    total = sum(count for count, _, _ in rows)
+    top = 'DevelopmentBoard'
+    instance_paths = rtl.instances(top)
+    per_instance = {}
+    per_block = {}
+
+    def add(table, key, count):
+        table[key] = table.get(key, 0) + count
+
+    for count, where, name in rows:
+        if where == 'host':
+            add(per_instance, ('(simulator host)', ''), count)
+            continue
+        if name.startswith('0x') and symbols:
+            i = bisect.bisect_right(addresses, int(name, 16)) - 1
+            name = symbols[i][1] if i >= 0 else name
+        m = PROF_RE.search(name)
+        if not m:
+            if name.startswith('0x'):
+                label = '(unresolved, is nm installed?)'
+            elif 'Verilated' in name or 'VL_' in name:
+                label = '(Verilator runtime)'
+            else:
+                label = '(model scheduling)'
+            add(per_instance, (label, ''), count)
+            continue
+        path = rtl.files.get(m.group(1))
+        line = int(m.group(2))
+        module = rtl.module_at(path, line) if path else None
+        if not module:
+            add(per_instance, ('(%s.v, not found in the RTL)' % m.group(1), ''), count)
+            continue
+        paths = instance_paths.get(module, [])
+        # Verilator names non-inlined scopes in the function (..._TOP__a__DOT__b__1__PROF_...)
+        scoped = [p for p in paths if '__' + p.split('.')[-1] + '__' in name]
+        if len(scoped) == 1:
+            instance = scoped[0]
+        elif len(paths) == 1:
+            instance = paths[0]
+        elif paths:
+            instance = '%s (%d instances)' % (module, len(paths))
+        else:
+            instance = module
+        add(per_instance, (instance, module), count)
+        start, text = rtl.statement_at(path, line)
+        add(per_block, (path, start, text, module), count)
+
+    def percent(count):
+        return round(100.0 * count / total, 1) if total else 0.0
+
+    return {
+        'samples': total,
+        'cpu_seconds': float(header.get('cpu_seconds', 0)),
+        'instances': [{'instance': k[0], 'module': k[1], 'samples': v, 'percent': percent(v)}
+                      for k, v in sorted(per_instance.items(), key=lambda kv: -kv[1])],
+        'blocks': [{'file': k[0], 'line': k[1], 'statement': k[2], 'module': k[3],
+                    'samples': v, 'percent': percent(v)}
+                   for k, v in sorted(per_block.items(), key=lambda kv: -kv[1])],
+    }
+
+
+def format_report(report, top):
+    out = []
+    out.append('RTL profile: %d samples over %.1f s of CPU time' % (report['samples'], report['cpu_seconds']))
+    out.append('')
+    out.append('Time per module instance')
+    out.append('  %6s  %8s  %-40s %s' % ('%Time', 'Samples', 'Instance', 'Module'))
+    for row in report['instances'][:top or None]:
+        out.append('  %6.1f  %8d  %-40s %s' % (row['percent'], row['samples'], row['instance'], row['module']))
+    out.append('')
+    out.append('Time per always block / statement')
+    out.append('  %6s  %8s  %-24s %s' % ('%Time', 'Samples', 'Location', 'Statement'))
+    for row in report['blocks'][:top or None]:
+        where = '%s:%d' % (os.path.basename(row['file']), row['line'])
+        out.append('  %6.1f  %8d  %-24s %s' % (row['percent'], row['samples'], where, row['statement']))
+    if not report['blocks']:
+        out.append('  (no samples in Verilog code; was the design verilated with --prof-cfuncs?)')
+    return '\n'.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Map --profile samples to RTL module instances and always blocks.')
+    parser.add_argument('samples', help='File written by the simulator with --profile=FILE')
+    parser.add_argument('--rtl', action='append', default=[], help='Directory with the RTL sources (repeatable)')
+    parser.add_argument('--top', type=int, default=15, help='Rows per table to print (default 15, 0 = all)')
+    parser.add_argument('--output', help='Also write the full report to this file')
+    parser.add_argument('--json', help='Also write the report as JSON to this file')
+    args = parser.parse_args()
+
+    try:
+        header, rows = read_samples(args.samples)
+    except OSError as e:
+        print('rtl_profile: %s' % e, file=sys.stderr)
+        return 1
+    report = build_report(header, rows, RtlIndex(args.rtl or ['.']))
+
+    print(format_report(report, args.top))
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            f.write(format_report(report, 0) + '\n')
+    if args.json:
+        with open(args.json, 'w', encoding='utf-8') as f:
+            json.dump(report, f, indent=2)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -14,11 +14,36 @@ if grep -qi microsoft /proc/version 2>/dev/null; then
     fi
 fi
 
-# Usage: ./run_simulation.sh [include_directory_path]
+# Usage: ./run_simulation.sh [include_directory_path] [--hot-reload] [--no-cache] [--release-perf[=FRAMES]]
+#                            [--profile[=FRAMES]] [--x-seeds[=K]] [--python] [--selftest] [--probes=FILE]
+#                            [simulator options...]
+# Simulator options start with "--" (e.g. --latency-probe); run the host with --help for the list
+# --hot-reload keeps the window open and rebuilds the design whenever an RTL file changes
+# --release-perf builds with profile-guided optimisation and LTO: an instrumented build
+#   runs FRAMES frames headless (default 300; drive the buttons with --input-script=FILE),
+#   then the design and host are rebuilt from that profile before the simulation starts
+# --profile builds the design with Verilator's --prof-cfuncs, runs FRAMES frames headless
+#   (default 300) and reports the time per module instance and always block (rtl_profile.py)
+# --x-seeds builds with randomised X initialisation, runs K seeds (default 8) headless in
+#   parallel next to an all-zero run and reports the seeds whose frame hashes differ
+# --python builds the design and the pyvga Python module (pyvga.cpp) into obj_dir instead
+#   of starting the simulator
+# --selftest builds and runs selftest.cpp, which checks the simulator host headless against
+#   a built-in design (mode detection, samplers, --pipeline, timing reports, exit codes);
+#   it needs neither Verilator nor DevelopmentBoard.v
+# --probes=FILE lists internal signals to sample and plot, one instance path per line
+#   (default: probes.txt in the include directory, or in the current directory)
+# --no-cache rebuilds and refreshes the shared simulator host and Verilator runtime (see VGA_SIM_CACHE below)
 
 # Get the absolute path of the script directory
 SCRIPT_DIR=$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)
 
+# The simulator sources (simulator.cpp, design_plugin.*, pyvga.cpp, selftest.cpp and the
+# Python helpers) are taken from the script directory. DevelopmentBoard.v and obj_dir are
+# in the current directory, so a project can run this script from the repository's sim/
+# (the examples do) instead of keeping its own copies.
+SRC_DIR="$SCRIPT_DIR"
+
 # Check for spaces in the script directory path (GNU Make limitation)
 if [[ "$SCRIPT_DIR" == *" "* ]]; then
     echo "Error: The project path contains spaces, which is not supported by GNU Make."
@@ -53,20 +78,14 @@ else
     SDL_LIBS="-lSDL2"
 fi
 
-# Set LDFLAGS for Verilator (prepend -LDFLAGS to each flag)
-LDFLAGS=""
-for flag in $SDL_LIBS; do
-    LDFLAGS="$LDFLAGS -LDFLAGS $flag"
-done
-
-# Set default path to the script directory
-DEFAULT_INCLUDE_DIR="$SCRIPT_DIR"
+# Set default path to the current directory (the one holding DevelopmentBoard.v)
+DEFAULT_INCLUDE_DIR="$(pwd)"
 
 # Check if user provided a path argument
-if [ $# -eq 0 ]; then
-    # User did not provide an argument, use the script directory
+if [ $# -eq 0 ] || [[ "$1" == --* ]]; then
+    # User did not provide an argument, use the current directory
     INCLUDE_DIR="$DEFAULT_INCLUDE_DIR"
-    echo "NOTE: No include directory path is provided, the directory where the script is located is used: $INCLUDE_DIR"
+    echo "NOTE: No include directory path is provided, the current directory is used: $INCLUDE_DIR"
 else
     # User provided an argument, use the specified path
     INCLUDE_DIR="$1"
@@ -74,20 +93,151 @@ else
     # Check if the provided path exists
     if [ ! -d "$INCLUDE_DIR" ]; then
         echo "Error: '$INCLUDE_DIR' does not exist"
-        echo "Tip: You can use the directory where the script is located without providing any parameters, or provide a valid directory path"
+        echo "Tip: You can use the current directory without providing any parameters, or provide a valid directory path"
         exit 1
     fi
+    shift
+fi
+
+# Remaining arguments are passed to the simulator, except the script's own options
+HOT_RELOAD=0
+USE_CACHE=1
+RELEASE_PERF_FRAMES=0
+PROFILE_FRAMES=0
+X_SEEDS=0
+PYTHON_MODULE=0
+SELF_TEST=0
+PROBES_FILE=""
+SIM_ARGS=()
+for arg in "$@"; do
+    if [ "$arg" == "--hot-reload" ]; then
+        HOT_RELOAD=1
+    elif [ "$arg" == "--no-cache" ]; then
+        USE_CACHE=0
+    elif [ "$arg" == "--release-perf" ]; then
+        RELEASE_PERF_FRAMES=300
+    elif [[ "$arg" == --release-perf=* ]]; then
+        RELEASE_PERF_FRAMES="${arg#--release-perf=}"
+        if ! [[ "$RELEASE_PERF_FRAMES" =~ ^[1-9][0-9]*$ ]]; then
+            echo "Error: --release-perf expects a number of frames, got '$RELEASE_PERF_FRAMES'"
+            exit 1
+        fi
+    elif [ "$arg" == "--profile" ]; then
+        PROFILE_FRAMES=300
+    elif [[ "$arg" == --profile=* ]]; then
+        PROFILE_FRAMES="${arg#--profile=}"
+        if ! [[ "$PROFILE_FRAMES" =~ ^[1-9][0-9]*$ ]]; then
+            echo "Error: --profile expects a number of frames, got '$PROFILE_FRAMES'"
+            exit 1
+        fi
+    elif [ "$arg" == "--python" ]; then
+        PYTHON_MODULE=1
+    elif [ "$arg" == "--selftest" ]; then
+        SELF_TEST=1
+    elif [[ "$arg" == --probes=* ]]; then
+        PROBES_FILE="${arg#--probes=}"
+        if [ ! -f "$PROBES_FILE" ]; then
+            echo "Error: --probes file '$PROBES_FILE' does not exist"
+            exit 1
+        fi
+    elif [ "$arg" == "--x-seeds" ]; then
+        X_SEEDS=8
+    elif [[ "$arg" == --x-seeds=* ]]; then
+        X_SEEDS="${arg#--x-seeds=}"
+        if ! [[ "$X_SEEDS" =~ ^[1-9][0-9]*$ ]]; then
+            echo "Error: --x-seeds expects a number of seeds, got '$X_SEEDS'"
+            exit 1
+        fi
+    else
+        SIM_ARGS+=("$arg")
+    fi
+done
+
+if [ $RELEASE_PERF_FRAMES -gt 0 ] && [ $HOT_RELOAD -eq 1 ]; then
+    echo "Error: --release-perf and --hot-reload cannot be combined"
+    echo "A profile-optimised build is only valid for the RTL it was profiled with"
+    exit 1
+fi
+if [ $PROFILE_FRAMES -gt 0 ] && { [ $HOT_RELOAD -eq 1 ] || [ $RELEASE_PERF_FRAMES -gt 0 ]; }; then
+    echo "Error: --profile cannot be combined with --hot-reload or --release-perf"
+    exit 1
+fi
+if [ $X_SEEDS -gt 0 ] && { [ $HOT_RELOAD -eq 1 ] || [ $RELEASE_PERF_FRAMES -gt 0 ] || [ $PROFILE_FRAMES -gt 0 ]; }; then
+    echo "Error: --x-seeds cannot be combined with --hot-reload, --release-perf or --profile"
+    exit 1
+fi
+if [ $PYTHON_MODULE -eq 1 ] && [ $((HOT_RELOAD + RELEASE_PERF_FRAMES + PROFILE_FRAMES + X_SEEDS)) -gt 0 ]; then
+    echo "Error: --python only builds the Python module and cannot be combined with other build modes"
+    exit 1
+fi
+if [ $SELF_TEST -eq 1 ] && [ $((HOT_RELOAD + RELEASE_PERF_FRAMES + PROFILE_FRAMES + X_SEEDS + PYTHON_MODULE)) -gt 0 ]; then
+    echo "Error: --selftest cannot be combined with other build modes"
+    exit 1
 fi
 
 echo "Start simulation..."
 echo "Include directories used: $INCLUDE_DIR"
 
 # Check if required files exist
-if [ ! -f "simulator.cpp" ]; then
-    echo "Error: simulator.cpp does not exist in the current directory"
+if [ ! -f "$SRC_DIR/simulator.cpp" ]; then
+    echo "Error: simulator.cpp does not exist in $SRC_DIR"
+    exit 1
+fi
+
+# --selftest: the host against its built-in design, no RTL or Verilator involved.
+# Remaining options go to the test, e.g. --verbose for the simulator's log.
+if [ $SELF_TEST -eq 1 ]; then
+    if [ ! -f "$SRC_DIR/selftest.cpp" ]; then
+        echo "Error: selftest.cpp does not exist in $SRC_DIR"
+        exit 1
+    fi
+    echo "---------------------------------"
+    echo "Self-test: Build the simulator host with its built-in test design..."
+    mkdir -p obj_dir
+    if ! ${CXX:-c++} -std=c++11 -O2 -pthread $SDL_CFLAGS "$SRC_DIR/selftest.cpp" -o obj_dir/selftest $SDL_LIBS -ldl; then
+        echo "Error: Building the self-test failed!"
+        exit 1
+    fi
+    obj_dir/selftest "${SIM_ARGS[@]}"
+    exit $?
+fi
+
+if [ $PROFILE_FRAMES -gt 0 ] && [ ! -f "$SRC_DIR/rtl_profile.py" ]; then
+    echo "Error: rtl_profile.py (needed by --profile) does not exist in $SRC_DIR"
     exit 1
 fi
 
+if [ ! -f "$SRC_DIR/design_plugin.cpp" ] || [ ! -f "$SRC_DIR/design_plugin.h" ]; then
+    echo "Error: design_plugin.cpp or design_plugin.h does not exist in $SRC_DIR"
+    exit 1
+fi
+
+# Internal signal probes: one instance path below DevelopmentBoard per line,
+# e.g. "vga_pic_inst.ball_x"; # starts a comment
+if [ -z "$PROBES_FILE" ]; then
+    for path in "$INCLUDE_DIR/probes.txt" probes.txt; do
+        if [ -f "$path" ]; then
+            PROBES_FILE="$path"
+            break
+        fi
+    done
+fi
+PROBES=()
+if [ -n "$PROBES_FILE" ]; then
+    while IFS= read -r line || [ -n "$line" ]; do
+        line="${line%%#*}"
+        line="${line//[[:space:]]/}"
+        line="${line#DevelopmentBoard.}"
+        [ -z "$line" ] && continue
+        if ! [[ "$line" =~ ^[A-Za-z_][A-Za-z0-9_]*(\.[A-Za-z_][A-Za-z0-9_]*)*$ ]]; then
+            echo "Error: '$line' in $PROBES_FILE is not an instance path like vga_pic_inst.ball_x"
+            exit 1
+        fi
+        PROBES+=("$line")
+    done < "$PROBES_FILE"
+    echo "Probes: ${#PROBES[@]} signal(s) from $PROBES_FILE"
+fi
+
 if [ ! -f "DevelopmentBoard.v" ]; then
     echo "Error: DevelopmentBoard.v does not exist in the current directory"
     exit 1
@@ -109,55 +259,431 @@ else
 fi
 
 
-# Step 1: Compile Verilog code with Verilator
-echo "---------------------------------"
-echo "Step 1: Run Verilator Compiler..."
-VERILATOR_OUTPUT=$(verilator -O3 --Wno-fatal --cc --exe -I"$INCLUDE_DIR" simulator.cpp DevelopmentBoard.v $LDFLAGS -CFLAGS "$SDL_CFLAGS" 2>&1)
-VERILATOR_EXIT_CODE=$?
-
-echo "$VERILATOR_OUTPUT"
-
-# Check if Verilator executed successfully
-if [ $VERILATOR_EXIT_CODE -ne 0 ] || [ ! -f "obj_dir/VDevelopmentBoard.mk" ]; then
-    echo "Error: Verilator compilation failed!"
-    echo "Possible causes:"
-    echo "1. Not provide correct path of RTLs"
-    echo "2. Verilator is not installed"
-    echo "   - Ubuntu: sudo apt install build-essential verilator"
-    echo "   - macOS:  brew install verilator"
-    echo "3. SDL2 is not installed"
-    echo "   - Ubuntu: sudo apt install libsdl2-dev"
-    echo "   - macOS:  brew install sdl2"
-    echo "4. The code contains syntax errors"
-    exit 1
+# The design is built as a plugin (a shared library with the C ABI in
+# design_plugin.h) that the simulator host loads at run time
+DESIGN_SO="$OBJ_DIR/design.so"
+# --savable generates the state serialisation behind the rewind checkpoints
+VERILATOR_FLAGS=(-O3 --Wno-fatal --stats --savable --cc --exe -CFLAGS -fPIC -LDFLAGS -shared -o libdesign.so)
+HOST_FLAGS="-std=c++11 -O2 -pthread"
+if [ $PROFILE_FRAMES -gt 0 ]; then
+    # One C++ function per always block / statement, named after its file and line;
+    # keep the compiler from inlining them back into eval()
+    VERILATOR_FLAGS+=(--prof-cfuncs -CFLAGS -fno-inline)
+fi
+if [ $X_SEEDS -gt 0 ]; then
+    # Registers without a reset value, and X assignments, get a value drawn from the
+    # +verilator+seed+ given at run time instead of a constant
+    VERILATOR_FLAGS+=(--x-assign unique --x-initial unique)
 fi
+# Extra compiler and linker flags for the design and the host, set by --release-perf.
+# Builds with extra flags never use or fill the shared cache.
+PERF_FLAGS=""
 
-echo "✓ Verilator compilation completed successfully!"
+# Shared build cache. The simulator host and the Verilator runtime (verilated.cpp
+# and friends) do not depend on the design, so they are compiled once per
+# compiler / Verilator version and reused by every project and example.
+# Override the location with VGA_SIM_CACHE.
+CACHE_ROOT="${VGA_SIM_CACHE:-${XDG_CACHE_HOME:-$HOME/.cache}/vga-simulator}"
+CXX_CMD="${CXX:-c++}"
 
-# Step 2: Build simulation executable
-echo "---------------------------------"
-echo "Step 2: Build the simulation executable..."
-# Export SDL flags for make
-export CXXFLAGS="$SDL_CFLAGS"
-make -j -C obj_dir -f VDevelopmentBoard.mk VDevelopmentBoard
-
-# Check if make built successfully
-if [ $? -ne 0 ]; then
-    echo "Error: Make build failed!"
-    echo "Please check the compilation error message above"
+hash_text() {
+    if command -v sha256sum &> /dev/null; then
+        sha256sum | cut -c1-16
+    else
+        shasum -a 256 | cut -c1-16
+    fi
+}
+
+# The runtime is compiled by Verilator's own makefile, so key it on that too
+VERILATOR_ROOT_DIR=$(verilator --getenv VERILATOR_ROOT 2>/dev/null)
+RUNTIME_KEY=$( {
+    verilator --version 2>&1
+    cat "$VERILATOR_ROOT_DIR/include/verilated.mk" 2>/dev/null
+    ${CXX:-g++} --version 2>&1 | head -n 1
+    echo "${VERILATOR_FLAGS[*]} $CXXFLAGS"
+} | hash_text)
+RUNTIME_CACHE="$CACHE_ROOT/runtime-$RUNTIME_KEY"
+
+HOST_KEY=$( {
+    $CXX_CMD --version 2>&1 | head -n 1
+    echo "$HOST_FLAGS $SDL_CFLAGS $SDL_LIBS"
+    cat "$SRC_DIR/simulator.cpp" "$SRC_DIR/design_plugin.h"
+} | hash_text)
+HOST_CACHE="$CACHE_ROOT/host-$HOST_KEY"
+
+# Verilator configuration marking every probed signal public, so it is neither
+# optimised away nor hidden. Signals are matched by name in every module.
+write_probe_config() {
+    local PROBE
+    mkdir -p "$OBJ_DIR"
+    {
+        echo '`verilator_config'
+        for PROBE in "${PROBES[@]}"; do
+            echo "public_flat_rd -module \"*\" -var \"${PROBE##*.}\""
+        done
+    } > "$OBJ_DIR/probes.vlt"
+}
+
+# obj_dir/vga_probes.h for design_plugin.cpp: the probes Verilator kept as
+# members of the model, as X("path", member) entries of VGA_PROBES
+write_probe_header() {
+    local ROOT_HEADER="$OBJ_DIR/VDevelopmentBoard___024root.h"
+    local ROOT="((model)->rootp)"
+    if [ ! -f "$ROOT_HEADER" ]; then
+        ROOT_HEADER="$OBJ_DIR/VDevelopmentBoard.h"      # Verilator before 4.210: members of the model
+        ROOT="(model)"
+    fi
+    local PROBE MEMBER ENTRIES=()
+    for PROBE in "${PROBES[@]}"; do
+        MEMBER="DevelopmentBoard__DOT__${PROBE//./__DOT__}"
+        # Scalars of up to 64 bits: CData..QData, or VL_SIG8..VL_SIG64( in older Verilator
+        if grep -Eq "^[[:space:]]*(CData|SData|IData|QData|VL_SIG8|VL_SIG16|VL_SIG|VL_SIG64)[^A-Za-z0-9_][^;]*[^A-Za-z0-9_]$MEMBER[[:space:]]*[;,]" "$ROOT_HEADER"; then
+            ENTRIES+=("    X(\"$PROBE\", $MEMBER) \\")
+        elif grep -qw "$MEMBER" "$ROOT_HEADER"; then
+            echo "Warning: probe $PROBE is wider than 64 bits or an array, it is left out"
+        else
+            echo "Warning: probe $PROBE was not found in the model (check the instance path), it is left out"
+        fi
+    done
+    {
+        echo "// Generated by run_simulation.sh from ${PROBES_FILE:-no probes file}; do not edit"
+        if [ ${#ENTRIES[@]} -gt 0 ]; then
+            echo "#include \"$(basename "$ROOT_HEADER")\""
+        fi
+        echo "#define VGA_PROBE_ROOT(model) $ROOT"
+        echo "#define VGA_PROBES(X) \\"
+        for PROBE in "${ENTRIES[@]}"; do
+            echo "$PROBE"
+        done
+        echo ""
+    } > "$OBJ_DIR/vga_probes.h"
+}
+
+build_design() {
+    # Step 1: Compile Verilog code with Verilator
+    echo "---------------------------------"
+    echo "Step 1: Run Verilator Compiler..."
+    local PERF_ARGS=()
+    if [ -n "$PERF_FLAGS" ]; then
+        PERF_ARGS=(-CFLAGS "$PERF_FLAGS" -LDFLAGS "$PERF_FLAGS")
+    fi
+    local PROBE_ARGS=()
+    if [ ${#PROBES[@]} -gt 0 ]; then
+        write_probe_config
+        PROBE_ARGS=("$OBJ_DIR/probes.vlt")
+    fi
+    VERILATOR_OUTPUT=$(verilator "${VERILATOR_FLAGS[@]}" "${PERF_ARGS[@]}" -I"$INCLUDE_DIR" "${PROBE_ARGS[@]}" "$SRC_DIR/design_plugin.cpp" DevelopmentBoard.v 2>&1)
+    VERILATOR_EXIT_CODE=$?
+
+    echo "$VERILATOR_OUTPUT"
+
+    # Check if Verilator executed successfully
+    if [ $VERILATOR_EXIT_CODE -ne 0 ] || [ ! -f "obj_dir/VDevelopmentBoard.mk" ]; then
+        echo "Error: Verilator compilation failed!"
+        echo "Possible causes:"
+        echo "1. Not provide correct path of RTLs"
+        echo "2. Verilator is not installed"
+        echo "   - Ubuntu: sudo apt install build-essential verilator"
+        echo "   - macOS:  brew install verilator"
+        echo "3. The code contains syntax errors"
+        return 1
+    fi
+
+    echo "✓ Verilator compilation completed successfully!"
+    write_probe_header
+
+    # Step 1b: Rank the warnings that hint at slow simulation (full report in obj_dir/perf_lint.txt)
+    echo "$VERILATOR_OUTPUT" > "$OBJ_DIR/verilator.log"
+    local PYTHON
+    PYTHON=$(command -v python3 || command -v python)
+    if [ -n "$PYTHON" ] && [ -f "$SRC_DIR/perf_lint.py" ]; then
+        echo "---------------------------------"
+        "$PYTHON" "$SRC_DIR/perf_lint.py" "$OBJ_DIR/verilator.log" --stats "$OBJ_DIR/VDevelopmentBoard__stats.txt" \
+            --rtl "$INCLUDE_DIR" --top 5 --output "$OBJ_DIR/perf_lint.txt" --json "$OBJ_DIR/perf_lint.json"
+    fi
+
+    # Step 2: Build the design plugin
+    echo "---------------------------------"
+    echo "Step 2: Build the design plugin..."
+    # Cached runtime objects keep their old time stamps, so make only compiles the model
+    local RUNTIME_CACHED=0
+    if [ -n "$PERF_FLAGS" ]; then
+        RUNTIME_CACHED=1    # Built with other flags: neither reuse nor publish
+    elif [ $USE_CACHE -eq 1 ] && [ -d "$RUNTIME_CACHE" ]; then
+        cp -p "$RUNTIME_CACHE"/* "$OBJ_DIR"/ && RUNTIME_CACHED=1
+        echo "Using the cached Verilator runtime: $RUNTIME_CACHE"
+    fi
+    if ! make -j -C obj_dir -f VDevelopmentBoard.mk; then
+        echo "Error: Make build failed!"
+        echo "Please check the compilation error message above"
+        return 1
+    fi
+    if [ $RUNTIME_CACHED -eq 0 ]; then
+        # Publish atomically so concurrent builds never see a half-filled cache entry
+        local TMP_CACHE="$RUNTIME_CACHE.tmp.$$"
+        mkdir -p "$TMP_CACHE" &&
+            cp -p "$OBJ_DIR"/verilated*.o "$TMP_CACHE"/ 2>/dev/null &&
+            { cp -p "$OBJ_DIR"/verilated*.d "$OBJ_DIR"/libverilated.a "$TMP_CACHE"/ 2>/dev/null; true; } &&
+            rm -rf "$RUNTIME_CACHE" && mv "$TMP_CACHE" "$RUNTIME_CACHE" &&
+            echo "Cached the Verilator runtime in $RUNTIME_CACHE"
+        rm -rf "$TMP_CACHE"
+    fi
+
+    # Replace the plugin atomically so a running simulator never sees a partial file
+    cp "$OBJ_DIR/libdesign.so" "$DESIGN_SO.tmp" && mv -f "$DESIGN_SO.tmp" "$DESIGN_SO" || return 1
+    echo "✓ Design plugin built successfully!"
+}
+
+# Step 2b: Build the simulator host (window, event loop, framebuffer)
+build_host() {
+    echo "---------------------------------"
+    echo "Step 2b: Build the simulator host..."
+    if [ -z "$PERF_FLAGS" ] && [ $USE_CACHE -eq 1 ] && [ -x "$HOST_CACHE/vga_host" ]; then
+        HOST_EXE="$HOST_CACHE/vga_host"
+        echo "Using the cached simulator host: $HOST_EXE"
+        return 0
+    fi
+    HOST_EXE="$OBJ_DIR/vga_host"
+    if ! $CXX_CMD $HOST_FLAGS $PERF_FLAGS $SDL_CFLAGS "$SRC_DIR/simulator.cpp" -o "$HOST_EXE" $SDL_LIBS -ldl; then
+        echo "Error: Building the simulator host failed!"
+        echo "SDL2 may not be installed"
+        echo "   - Ubuntu: sudo apt install libsdl2-dev"
+        echo "   - macOS:  brew install sdl2"
+        return 1
+    fi
+    if [ -z "$PERF_FLAGS" ]; then
+        local TMP_CACHE="$HOST_CACHE.tmp.$$"
+        mkdir -p "$TMP_CACHE" && cp -p "$HOST_EXE" "$TMP_CACHE"/ &&
+            rm -rf "$HOST_CACHE" && mv "$TMP_CACHE" "$HOST_CACHE" &&
+            echo "Cached the simulator host in $HOST_CACHE"
+        rm -rf "$TMP_CACHE"
+    fi
+}
+
+# Run the current build headless for RELEASE_PERF_FRAMES frames with the user's
+# simulator options and print its simulated clock rate in MHz
+measure_build() {
+    local LOG="$PERF_DIR/$1.log"
+    "$HOST_EXE" --design="$DESIGN_SO" "${SIM_ARGS[@]}" --headless --frames=$RELEASE_PERF_FRAMES > "$LOG" 2>&1
+    local STATUS=$?
+    if [ $STATUS -ne 0 ]; then
+        echo "Error: The $1 run failed with exit code $STATUS, see $LOG" >&2
+        tail -n 5 "$LOG" >&2
+        return 1
+    fi
+    sed -n 's/^Simulated clock: *\([0-9.]*\) MHz$/\1/p' "$LOG" | tail -n 1
+}
+
+# --release-perf: plain build as the baseline, an instrumented build to collect
+# a profile, then the final build optimised with that profile and LTO
+release_perf_build() {
+    PERF_DIR="$(pwd)/$OBJ_DIR/pgo"
+    mkdir -p "$PERF_DIR/profile"
+    local PGO_GEN="-fprofile-generate=$PERF_DIR/profile"
+    local PGO_USE="-fprofile-use=$PERF_DIR/profile -fprofile-correction -Wno-missing-profile"
+    local LTO="-flto -ffat-lto-objects"
+    if $CXX_CMD --version 2>&1 | grep -qi clang; then
+        # Clang writes raw profiles that have to be merged with llvm-profdata
+        PGO_USE="-fprofile-use=$PERF_DIR/profile/merged.profdata"
+        LTO="-flto=thin"
+        local PROFDATA=llvm-profdata
+        if ! command -v $PROFDATA &> /dev/null && command -v xcrun &> /dev/null; then
+            PROFDATA="xcrun llvm-profdata"
+        fi
+    fi
+
+    echo "---------------------------------"
+    echo "Release-perf 1/3: Baseline build..."
+    PERF_FLAGS=""
+    build_design && build_host || return 1
+    echo "Measuring the baseline over $RELEASE_PERF_FRAMES frames..."
+    local BASE_MHZ
+    BASE_MHZ=$(measure_build baseline) || return 1
+
+    echo "---------------------------------"
+    echo "Release-perf 2/3: Instrumented build..."
+    # make does not track compiler flags, so drop the objects of the previous stage
+    rm -f "$OBJ_DIR"/*.o "$OBJ_DIR"/*.a
+    PERF_FLAGS="$PGO_GEN"
+    build_design && build_host || return 1
+    echo "Collecting a profile over $RELEASE_PERF_FRAMES frames..."
+    measure_build training > /dev/null || return 1
+    if [ -n "$PROFDATA" ]; then
+        $PROFDATA merge -o "$PERF_DIR/profile/merged.profdata" "$PERF_DIR"/profile/*.profraw || return 1
+    fi
+
+    echo "---------------------------------"
+    echo "Release-perf 3/3: Profile-optimised LTO build..."
+    rm -f "$OBJ_DIR"/*.o "$OBJ_DIR"/*.a
+    PERF_FLAGS="$PGO_USE $LTO"
+    build_design && build_host || return 1
+    echo "Measuring the optimised build over $RELEASE_PERF_FRAMES frames..."
+    local PGO_MHZ
+    PGO_MHZ=$(measure_build optimised) || return 1
+
+    echo "---------------------------------"
+    echo "Release-perf: simulated clock $BASE_MHZ MHz -> $PGO_MHZ MHz" \
+         "($(awk -v a="$BASE_MHZ" -v b="$PGO_MHZ" 'BEGIN { if (a > 0) printf "%+.1f%%", (b / a - 1) * 100; else print "n/a" }'))"
+}
+
+# --python: the pyvga extension module, with the simulator host compiled in (no main())
+build_python_module() {
+    echo "---------------------------------"
+    echo "Step 2b: Build the pyvga Python module..."
+    local PYTHON PY_INCLUDE PY_SUFFIX
+    PYTHON=$(command -v python3 || command -v python)
+    if [ -z "$PYTHON" ] || [ ! -f "$SRC_DIR/pyvga.cpp" ]; then
+        echo "Error: --python needs Python 3 and pyvga.cpp in $SRC_DIR"
+        return 1
+    fi
+    PY_INCLUDE=$("$PYTHON" -c 'import sysconfig; print(sysconfig.get_paths()["include"])')
+    PY_SUFFIX=$("$PYTHON" -c 'import sysconfig; print(sysconfig.get_config_var("EXT_SUFFIX") or ".so")')
+    local UNDEFINED=""
+    if [ "$OS" == "Darwin" ]; then
+        UNDEFINED="-undefined dynamic_lookup"   # Python symbols come from the interpreter
+    fi
+    if ! $CXX_CMD $HOST_FLAGS -fPIC -shared -I"$PY_INCLUDE" $SDL_CFLAGS "$SRC_DIR/pyvga.cpp" \
+            -o "$OBJ_DIR/pyvga$PY_SUFFIX" $UNDEFINED $SDL_LIBS -ldl; then
+        echo "Error: Building the Python module failed (are the Python headers installed, e.g. python3-dev?)"
+        return 1
+    fi
+    echo "✓ Built $OBJ_DIR/pyvga$PY_SUFFIX"
+    echo "Use it from Python with:"
+    echo "    import sys; sys.path.insert(0, '$OBJ_DIR')"
+    echo "    import pyvga"
+    echo "    sim = pyvga.Simulator('$DESIGN_SO'); sim.run_frames(10); print(sim.frame.shape, sim.leds)"
+}
+
+if [ $PYTHON_MODULE -eq 1 ]; then
+    build_design && build_python_module
+    exit $?
+elif [ $RELEASE_PERF_FRAMES -gt 0 ]; then
+    if ! release_perf_build; then
+        echo "Error: The release-perf build failed"
+        exit 1
+    fi
+elif ! build_design || ! build_host; then
     exit 1
 fi
 
 echo "✓ Simulation executable file built successfully!"
 
+if [ $PROFILE_FRAMES -gt 0 ]; then
+    # Step 3 (--profile): headless run with CPU sampling, then map the samples to the RTL
+    echo "---------------------------------"
+    echo "Step 3: Profile $PROFILE_FRAMES frames..."
+    SAMPLES="$OBJ_DIR/profile_samples.txt"
+    "$HOST_EXE" --design="$DESIGN_SO" "${SIM_ARGS[@]}" --headless --frames=$PROFILE_FRAMES --profile="$SAMPLES"
+    SIMULATION_EXIT_CODE=$?
+    PYTHON=$(command -v python3 || command -v python)
+    if [ $SIMULATION_EXIT_CODE -eq 0 ] && [ -n "$PYTHON" ]; then
+        echo "----------------------------------------"
+        "$PYTHON" "$SRC_DIR/rtl_profile.py" "$SAMPLES" --rtl "$INCLUDE_DIR" --rtl . \
+            --output "$OBJ_DIR/rtl_profile.txt" --json "$OBJ_DIR/rtl_profile.json"
+        echo "Full report: $OBJ_DIR/rtl_profile.txt and $OBJ_DIR/rtl_profile.json"
+    elif [ -z "$PYTHON" ]; then
+        echo "Python 3 not found; raw samples are in $SAMPLES"
+    fi
+    exit $SIMULATION_EXIT_CODE
+fi
+
+# --x-seeds: run the design from K random initial states at once and compare the
+# frame hashes with a run where everything starts at zero (Verilator's default)
+x_seed_runs() {
+    local DIR="$OBJ_DIR/xseeds"
+    local FRAMES=300
+    local JOBS
+    JOBS=$(getconf _NPROCESSORS_ONLN 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 4)
+    mkdir -p "$DIR"
+    echo "---------------------------------"
+    echo "Step 3: Run $X_SEEDS random initial states and an all-zero one ($JOBS at a time)..."
+    local SEED
+    for SEED in $(seq 0 $X_SEEDS); do
+        while [ $(jobs -rp | wc -l) -ge $JOBS ]; do
+            sleep 0.2
+        done
+        local RAND=(+verilator+rand+reset+2 +verilator+seed+$SEED)
+        if [ $SEED -eq 0 ]; then
+            RAND=(+verilator+rand+reset+0)
+        fi
+        # The user's options come last so --frames or --input-script can override the defaults
+        ( "$HOST_EXE" --design="$DESIGN_SO" --headless --frames=$FRAMES --hash-every=1 --timing-report=0 \
+              "${SIM_ARGS[@]}" "${RAND[@]}" > "$DIR/seed-$SEED.log" 2>&1
+          echo $? > "$DIR/seed-$SEED.status" ) &
+    done
+    wait
+
+    local REPORT="$DIR/report.txt"
+    local DIFFERING=()
+    sed -n 's/^\[Hash\] Frame \([0-9]*\) \([0-9a-f]*\)$/\1 \2/p' "$DIR/seed-0.log" > "$DIR/seed-0.hashes"
+    {
+        echo "X-initialisation: $X_SEEDS seeds compared with all registers starting at zero"
+        echo "  seed 0 (all zero): $(wc -l < "$DIR/seed-0.hashes" | tr -d ' ') frames, exit code $(cat "$DIR/seed-0.status")"
+        for SEED in $(seq 1 $X_SEEDS); do
+            sed -n 's/^\[Hash\] Frame \([0-9]*\) \([0-9a-f]*\)$/\1 \2/p' "$DIR/seed-$SEED.log" > "$DIR/seed-$SEED.hashes"
+            local STATUS FIRST
+            STATUS=$(cat "$DIR/seed-$SEED.status")
+            # First frame whose hash differs from the all-zero run (or that only one of them reached)
+            FIRST=$(awk 'NR == FNR { ref[$1] = $2; n = FNR; next }
+                         { seen++; if (ref[$1] != $2) { print $1; found = 1; exit } }
+                         END { if (!found && seen != n) print (seen < n ? seen : n) + 1 }' \
+                    "$DIR/seed-0.hashes" "$DIR/seed-$SEED.hashes")
+            if [ -n "$FIRST" ] || [ "$STATUS" != "$(cat "$DIR/seed-0.status")" ]; then
+                DIFFERING+=($SEED)
+                echo "  seed $SEED: DIFFERS from frame ${FIRST:-?}, exit code $STATUS (log: $DIR/seed-$SEED.log)"
+            else
+                echo "  seed $SEED: same frames"
+            fi
+        done
+        if [ ${#DIFFERING[@]} -eq 0 ]; then
+            echo "Every seed matches: the output does not depend on the initial register values"
+        else
+            echo "Seeds with different output: ${DIFFERING[*]}"
+            echo "Some register is read before it is reset or assigned. Give it a reset value, then"
+            echo "replay a seed in the window with: ./run_simulation.sh <RTL> +verilator+rand+reset+2 +verilator+seed+N"
+        fi
+    } > "$REPORT"     # Not a pipe into tee: DIFFERING has to survive the block
+    cat "$REPORT"
+    [ ${#DIFFERING[@]} -eq 0 ]
+}
+
+if [ $X_SEEDS -gt 0 ]; then
+    x_seed_runs
+    exit $?
+fi
+
 # Step 3: Run simulation
 echo "---------------------------------"
 echo "Step 3: Start the simulation..."
 echo "----------------------------------------"
-obj_dir/VDevelopmentBoard
+if [ $HOT_RELOAD -eq 1 ]; then
+    # The host reloads design.so whenever it changes; rebuild it on every RTL edit
+    "$HOST_EXE" --design="$DESIGN_SO" --watch-design "${SIM_ARGS[@]}" &
+    HOST_PID=$!
+    RTL_STAMP="$OBJ_DIR/.rtl_stamp"
+    touch "$RTL_STAMP"
+    echo "Hot reload: watching $INCLUDE_DIR for RTL changes"
+    while kill -0 $HOST_PID 2>/dev/null; do
+        sleep 1
+        CHANGED=$(find "$INCLUDE_DIR" DevelopmentBoard.v -newer "$RTL_STAMP" \( -name '*.v' -o -name '*.sv' -o -name '*.vh' -o -name '*.svh' \) 2>/dev/null | head -n 1)
+        if [ -n "$CHANGED" ] && kill -0 $HOST_PID 2>/dev/null; then
+            touch "$RTL_STAMP"
+            echo "Hot reload: $CHANGED changed, rebuilding the design..."
+            if build_design; then
+                echo "✓ Hot reload: new design handed to the simulator"
+            else
+                echo "Hot reload: build failed, the simulator keeps the previous design"
+            fi
+        fi
+    done
+    wait $HOST_PID
+    SIMULATION_EXIT_CODE=$?
+else
+    "$HOST_EXE" --design="$DESIGN_SO" "${SIM_ARGS[@]}"
+    SIMULATION_EXIT_CODE=$?
+fi
 
 # Check if simulation ran successfully
-SIMULATION_EXIT_CODE=$?
 echo "----------------------------------------"
 
 if [ $SIMULATION_EXIT_CODE -ne 0 ]; then
@@ -0,0 +1,591 @@
+// Headless self-test of the simulator host: `./run_simulation.sh --selftest`.
+//
+// The host is compiled in without main() (as in pyvga.cpp) and drives a small
+// built-in design instead of a Verilated one, so the test needs neither
+// Verilator nor an RTL project. Every case runs in a forked child, which starts
+// from the host's initial globals; the parent compares what the children
+// report. POSIX only. `--verbose` keeps the children's log on stderr.
+#define VGA_SIM_NO_MAIN
+#include "simulator.cpp"
+
+#include <functional>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------
+// Built-in design: the sync timing of one VESA_MODES entry and a picture that
+// moves one pixel per frame (three while B2 is held). The LEDs follow the
+// buttons as in the examples. The fields below break it on purpose.
+struct TestDesignConfig {
+    int mode = 0;                   // Index into VESA_MODES
+    int clocks_per_pixel = 0;       // 0 = the mode's own
+    bool h_polarity = true;         // Level of each sync pin during its pulse
+    bool v_polarity = true;
+    bool h_sync = true;             // false: the pin never pulses
+    bool v_sync = true;
+    int h_front_extra = 0;          // Pixels added to the front porch
+    bool blank_noise = false;       // One lit pixel in every front porch
+    bool still = false;             // The picture does not move
+    uint64_t glitch_frame = 0;      // From this frame on the first pixel is inverted (0 = never)
+};
+static TestDesignConfig g_test_design;  // Copied by every create()
+
+struct TestDesign {
+    TestDesignConfig cfg;
+    VgaTiming t;
+    int h_total = 0;
+    int x = 0, y = 0, sub = 0;      // Counters from the sync leading edges, pixel clock divider
+    uint64_t frame = 0;
+    int offset = 0;                 // How far the picture has moved
+    uint8_t clk = 0;
+    uint8_t reset = 1, B2 = 1, B3 = 1, B4 = 1, B5 = 1;
+
+    void rising_edge() {
+        if (!reset) {
+            x = y = sub = offset = 0;
+            frame = 0;
+            return;
+        }
+        if (++sub < t.clocks_per_pixel) return;
+        sub = 0;
+        if (++x < h_total) return;
+        x = 0;
+        if (++y < t.v_total()) return;
+        y = 0;
+        frame++;
+        if (!cfg.still) offset += B2 ? 1 : 3;
+    }
+
+    void outputs(VgaDesignPorts* p) const {
+        bool h_pulse = cfg.h_sync && x < t.h_sync;
+        bool v_pulse = cfg.v_sync && y < t.v_sync;
+        p->h_sync = h_pulse == cfg.h_polarity;
+        p->v_sync = v_pulse == cfg.v_polarity;
+        int ax = x - t.h_start();
+        int ay = y - t.v_start();
+        uint16_t rgb = 0;
+        if (reset && ax >= 0 && ax < t.h_active && ay >= 0 && ay < t.v_active) {
+            rgb = (uint16_t)((((ax + offset) & 0xFF) * 0x0841 ^ (ay & 0x3F) << 5) | 1);
+            if (cfg.glitch_frame > 0 && frame >= cfg.glitch_frame && ax == 0 && ay == 0) rgb ^= 0xFFFF;
+        } else if (reset && cfg.blank_noise && x == h_total - 1) {
+            rgb = 0x001F;
+        }
+        p->rgb = rgb;
+        p->led1 = B2;
+        p->led2 = B3;
+        p->led3 = B4;
+        p->led4 = B5;
+        p->led5 = reset;
+    }
+
+    void inputs(const VgaDesignPorts* p) {
+        reset = p->reset;
+        B2 = p->B2;
+        B3 = p->B3;
+        B4 = p->B4;
+        B5 = p->B5;
+    }
+};
+
+static void* test_create(int, char**) {
+    TestDesign* d = new TestDesign;
+    d->cfg = g_test_design;
+    d->t = VESA_MODES[d->cfg.mode];
+    if (d->cfg.clocks_per_pixel > 0) d->t.clocks_per_pixel = d->cfg.clocks_per_pixel;
+    d->h_total = d->t.h_total() + d->cfg.h_front_extra;
+    return d;
+}
+
+static void test_destroy(void* design) {
+    delete static_cast<TestDesign*>(design);
+}
+
+static void test_eval(void* design, VgaDesignPorts* ports, uint64_t) {
+    TestDesign* d = static_cast<TestDesign*>(design);
+    d->inputs(ports);
+    if (!d->reset || (ports->clk && !d->clk)) d->rising_edge();    // Asynchronous reset
+    d->clk = ports->clk;
+    d->outputs(ports);
+}
+
+static uint64_t test_run_pixels(void* design, VgaDesignPorts* ports, uint64_t time,
+                                int clocks_per_pixel, uint32_t sync_xor, uint32_t* samples, int count) {
+    TestDesign* d = static_cast<TestDesign*>(design);
+    d->inputs(ports);
+    for (int i = 0; i < count; i++) {
+        for (int c = 0; c < clocks_per_pixel; c++) {
+            d->rising_edge();
+            time += 2;
+        }
+        d->outputs(ports);
+        samples[i] = ((uint32_t)ports->rgb | (uint32_t)(ports->h_sync & 1) << 16 |
+                      (uint32_t)(ports->v_sync & 1) << 17) ^ sync_xor;
+    }
+    d->clk = 0;
+    ports->clk = 0;
+    return time;
+}
+
+static int test_got_finish(void*) {
+    return 0;
+}
+
+static const uint8_t* test_save_state(void* design, size_t* size) {
+    *size = sizeof(TestDesign);
+    return static_cast<const uint8_t*>(design);
+}
+
+static int test_restore_state(void* design, const uint8_t* data, size_t size) {
+    if (size != sizeof(TestDesign)) return 1;
+    std::memcpy(design, data, size);
+    return 0;
+}
+
+static int test_probe_count(void*) {
+    return 0;
+}
+
+static const char* test_probe_name(void*, int) {
+    return nullptr;
+}
+
+static void test_read_probes(void*, uint64_t*) {}
+
+static const VgaDesignApi TEST_DESIGN_API = {
+    VGA_DESIGN_ABI_VERSION,
+    sizeof(VgaDesignPorts),
+    test_create,
+    test_destroy,
+    test_eval,
+    test_run_pixels,
+    test_got_finish,
+    test_save_state,
+    test_restore_state,
+    test_probe_count,
+    test_probe_name,
+    test_read_probes,
+};
+
+// Stands in for load_design(): the host never sees a shared object
+static void install_test_design(DesignPlugin& d, const TestDesignConfig& cfg) {
+    g_test_design = cfg;
+    d.api = &TEST_DESIGN_API;
+    d.instance = TEST_DESIGN_API.create(0, nullptr);
+}
+
+// ---------------------------------------------------------------------------
+// Children
+
+static bool g_verbose = false;
+static int g_failures = 0;
+static int g_cases = 0;
+
+static void report(bool pass, const std::string& name, const std::string& detail = "") {
+    g_cases++;
+    if (!pass) g_failures++;
+    std::cout << "[SelfTest] " << (pass ? "PASS " : "FAIL ") << name;
+    if (!detail.empty()) std::cout << ": " << detail;
+    std::cout << std::endl;
+}
+
+// Run body in a forked child; it writes `size` bytes of result to out.
+// Returns false if the child crashed or wrote nothing.
+static bool run_child(const std::function<void(void*)>& body, void* out, size_t size) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        if (!g_verbose && !freopen("/dev/null", "w", stderr)) _exit(101);
+        std::vector<char> result(size, 0);
+        body(result.data());
+        ssize_t written = write(fds[1], result.data(), size);
+        _exit(written == (ssize_t)size ? 0 : 102);
+    }
+    close(fds[1]);
+    size_t got = 0;
+    for (ssize_t n; got < size && (n = read(fds[0], (char*)out + got, size - got)) > 0;) {
+        got += (size_t)n;
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return got == size && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// What a headless host run ended with
+struct HostRun {
+    bool ok;                        // Child finished and the options parsed
+    int exit_code;
+    uint64_t frames;
+    uint64_t hash;                  // Last finished frame
+    uint64_t violations;            // Timing reports with a violation
+    char mode[32];
+    bool h_polarity, v_polarity;
+};
+
+// Run the host headless on the built-in design with these simulator options,
+// as main() would; `reference` adds a --diff reference design
+static HostRun run_host(const TestDesignConfig& design, const std::vector<std::string>& args,
+                        const TestDesignConfig* reference = nullptr) {
+    HostRun r = {};
+    bool finished = run_child([&](void* out) {
+        std::vector<std::string> storage(1, "selftest");
+        storage.insert(storage.end(), args.begin(), args.end());
+        std::vector<char*> argv;
+        for (std::string& s : storage) argv.push_back(&s[0]);
+        argv.push_back(nullptr);
+        HostRun& res = *static_cast<HostRun*>(out);
+        if (!parse_options((int)storage.size(), argv.data())) return;
+        install_test_design(g_design, design);
+        if (reference) {
+            install_test_design(g_reference, *reference);
+        }
+        simulation_loop();
+        res.ok = true;
+        res.exit_code = g_exit_code.load();
+        res.frames = g_vsync_count;
+        res.hash = g_last_frame_hash;
+        res.violations = g_sync_monitor.violations;
+        snprintf(res.mode, sizeof(res.mode), "%s", g_timing.name);
+        res.h_polarity = g_h_sync_polarity;
+        res.v_polarity = g_v_sync_polarity;
+    }, &r, sizeof(r));
+    r.ok = r.ok && finished;
+    return r;
+}
+
+static std::string describe(const HostRun& r) {
+    if (!r.ok) return "the run did not finish";
+    char text[128];
+    snprintf(text, sizeof(text), "exit %d, %llu frames in %s, hash %016llx, %llu violation reports",
+             r.exit_code, (unsigned long long)r.frames, r.mode, (unsigned long long)r.hash,
+             (unsigned long long)r.violations);
+    return text;
+}
+
+// Run a check that needs fresh host globals in a child; it returns a message, empty when it passed
+static void run_check(const std::string& name, const std::function<std::string()>& check) {
+    char message[256] = {};
+    bool finished = run_child([&](void* out) {
+        snprintf(static_cast<char*>(out), sizeof(message), "%s", check().c_str());
+    }, message, sizeof(message));
+    report(finished && message[0] == 0, name, finished ? message : "the check crashed");
+}
+
+// ---------------------------------------------------------------------------
+// Cases
+
+// Mode detection on every VESA mode, at its own pixel clock and with sync
+// polarities the other way round, fed clk by clk as in run_timing_detection()
+static void test_timing_detection() {
+    const bool polarities[][2] = {{true, true}, {false, false}, {true, false}, {false, true}};
+    for (int m = 0; m < NUM_VESA_MODES; m++) {
+        for (const bool* pol : polarities) {
+            for (int cpp : {VESA_MODES[m].clocks_per_pixel, 4}) {
+                TestDesignConfig cfg;
+                cfg.mode = m;
+                cfg.clocks_per_pixel = cpp;
+                cfg.h_polarity = pol[0];
+                cfg.v_polarity = pol[1];
+                g_test_design = cfg;
+                TestDesign* d = static_cast<TestDesign*>(test_create(0, nullptr));
+                VgaDesignPorts ports = {};
+                ports.reset = ports.B2 = ports.B3 = ports.B4 = ports.B5 = 1;
+                TimingDetector detector;
+                bool done = false;
+                while (!done && detector.ticks() < MAX_DETECT_TICKS * 2) {
+                    ports.clk = 1;
+                    test_eval(d, &ports, 0);
+                    ports.clk = 0;
+                    test_eval(d, &ports, 0);
+                    done = detector.feed(ports.h_sync, ports.v_sync, ports.rgb);
+                }
+                test_destroy(d);
+
+                VgaTiming t;
+                bool h_pol = false, v_pol = false, vesa = false;
+                bool resolved = done && detector.resolve(t, h_pol, v_pol, vesa);
+                char name[96];
+                snprintf(name, sizeof(name), "detect %s at %d clk/pixel, sync %c%c", VESA_MODES[m].name, cpp,
+                         pol[0] ? '+' : '-', pol[1] ? '+' : '-');
+                std::ostringstream got;
+                if (resolved) {
+                    got << (vesa ? "" : "non-VESA ") << t.name << " at " << t.clocks_per_pixel
+                        << " clk/pixel, sync " << (h_pol ? '+' : '-') << (v_pol ? '+' : '-');
+                }
+                bool pass = resolved && vesa && strcmp(t.name, VESA_MODES[m].name) == 0 &&
+                            t.clocks_per_pixel == cpp && h_pol == pol[0] && v_pol == pol[1];
+                report(pass, name, pass ? "" : resolved ? "got " + got.str() : "nothing detected");
+            }
+        }
+    }
+}
+
+// The same frames whichever way they are sampled: --pipeline, the generic
+// sampler, and --mode instead of detection
+static void test_frame_hashes() {
+    const std::string frames = "--frames=12";
+    TestDesignConfig cfg;
+    HostRun base = run_host(cfg, {"--headless", frames});
+    report(base.ok && base.exit_code == 0 && base.frames == 12 && strcmp(base.mode, "640x480@60") == 0,
+           "detected run", describe(base));
+    const std::vector<std::vector<std::string>> variants = {
+        {"--pipeline"}, {"--generic-sampler"}, {"--generic-sampler", "--pipeline"},
+    };
+    for (const std::vector<std::string>& v : variants) {
+        std::vector<std::string> args = {"--headless", frames};
+        args.insert(args.end(), v.begin(), v.end());
+        HostRun r = run_host(cfg, args);
+        std::string name = "hash with";
+        for (const std::string& a : v) name += " " + a;
+        report(r.ok && r.exit_code == 0 && r.hash == base.hash, name, describe(r));
+    }
+
+    // Negative sync pulses only flip the pins
+    TestDesignConfig negative;
+    negative.h_polarity = negative.v_polarity = false;
+    for (const char* extra : {"", "--pipeline"}) {
+        std::vector<std::string> args = {"--headless", frames};
+        if (*extra) args.push_back(extra);
+        HostRun r = run_host(negative, args);
+        report(r.ok && r.hash == base.hash && !r.h_polarity && !r.v_polarity,
+               std::string("hash with negative sync ") + extra, describe(r));
+    }
+
+    // Every mode: the specialised sampler against the generic one, serial and pipelined
+    for (int m = 0; m < NUM_VESA_MODES; m++) {
+        TestDesignConfig mode_cfg;
+        mode_cfg.mode = m;
+        std::string mode = std::string("--mode=") + VESA_MODES[m].name;
+        HostRun fast = run_host(mode_cfg, {"--headless", frames, mode});
+        HostRun generic = run_host(mode_cfg, {"--headless", frames, mode, "--generic-sampler"});
+        HostRun piped = run_host(mode_cfg, {"--headless", frames, mode, "--pipeline"});
+        HostRun detected = run_host(mode_cfg, {"--headless", frames});
+        std::string name = std::string(VESA_MODES[m].name) + ": ";
+        report(fast.ok && fast.exit_code == 0 && fast.frames == 12, name + "--mode run", describe(fast));
+        report(generic.ok && generic.hash == fast.hash, name + "generic sampler", describe(generic));
+        report(piped.ok && piped.hash == fast.hash, name + "--pipeline", describe(piped));
+        report(detected.ok && strcmp(detected.mode, VESA_MODES[m].name) == 0, name + "detected", describe(detected));
+    }
+
+    // Detection runs the design for a few frames first, so compare a still picture
+    TestDesignConfig still;
+    still.still = true;
+    HostRun detected = run_host(still, {"--headless", frames});
+    HostRun fixed = run_host(still, {"--headless", frames, "--mode=640x480@60"});
+    report(detected.ok && fixed.ok && detected.hash == fixed.hash, "still picture, detected and --mode",
+           describe(detected) + " / " + describe(fixed));
+}
+
+// Timing reports: exact periods and pulse widths, black blanking
+static void test_sync_monitor() {
+    std::vector<std::string> args = {"--headless", "--frames=12", "--mode=640x480@60", "--timing-report=4"};
+    TestDesignConfig good;
+    HostRun r = run_host(good, args);
+    report(r.ok && r.exit_code == 0 && r.violations == 0, "timing report of a correct design", describe(r));
+
+    // One pixel too many per line is inside 0.5% of the pixel clock, but not VESA timing
+    TestDesignConfig long_line;
+    long_line.h_front_extra = 1;
+    r = run_host(long_line, args);
+    report(r.ok && r.exit_code == 0 && r.violations == 3, "line one pixel long, 3 reports", describe(r));
+
+    TestDesignConfig noise;
+    noise.blank_noise = true;
+    r = run_host(noise, args);
+    report(r.ok && r.exit_code == 0 && r.violations == 3, "lit pixel in blanking, 3 reports", describe(r));
+
+    std::vector<std::string> pipelined = args;
+    pipelined.push_back("--pipeline");
+    r = run_host(noise, pipelined);
+    report(r.ok && r.violations == 3, "lit pixel in blanking with --pipeline", describe(r));
+}
+
+// Batch runs stop with the watchdog's exit codes
+static void test_exit_codes() {
+    TestDesignConfig no_h;
+    no_h.h_sync = false;
+    HostRun r = run_host(no_h, {"--headless", "--mode=640x480@60", "--watchdog=20"});
+    report(r.ok && r.exit_code == EXIT_NO_H_SYNC, "exit 3 without h_sync", describe(r));
+    r = run_host(no_h, {"--headless", "--mode=640x480@60", "--watchdog=20", "--pipeline"});
+    report(r.ok && r.exit_code == EXIT_NO_H_SYNC, "exit 3 without h_sync, --pipeline", describe(r));
+
+    TestDesignConfig no_v;
+    no_v.v_sync = false;
+    r = run_host(no_v, {"--headless", "--mode=640x480@60", "--watchdog=20"});
+    report(r.ok && r.exit_code == EXIT_NO_V_SYNC, "exit 4 without v_sync", describe(r));
+
+    TestDesignConfig still;
+    still.still = true;
+    r = run_host(still, {"--headless", "--frames=50", "--watchdog-frames=5"});
+    report(r.ok && r.exit_code == EXIT_FROZEN && r.frames < 50, "exit 5 on a still picture", describe(r));
+    TestDesignConfig moving;
+    r = run_host(moving, {"--headless", "--frames=20", "--watchdog-frames=5"});
+    report(r.ok && r.exit_code == 0 && r.frames == 20, "no exit 5 on a moving picture", describe(r));
+
+    TestDesignConfig glitch;
+    glitch.glitch_frame = 4;
+    r = run_host(moving, {"--headless", "--frames=20", "--diff=builtin", "--diff-image=/dev/null"}, &glitch);
+    report(r.ok && r.exit_code == EXIT_DIVERGED && r.frames < 20, "exit 6 when the --diff reference differs",
+           describe(r));
+    r = run_host(moving, {"--headless", "--frames=10", "--diff=builtin", "--diff-image=/dev/null"}, &moving);
+    report(r.ok && r.exit_code == 0, "no exit 6 against the same design", describe(r));
+
+    TestDesignConfig long_line;
+    long_line.h_front_extra = 1;
+    r = run_host(long_line, {"--headless", "--frames=30", "--mode=640x480@60", "--timing-report=4",
+                             "--strict-timing"});
+    report(r.ok && r.exit_code == EXIT_CHECK_FAILED && r.frames < 30, "exit 7 with --strict-timing", describe(r));
+}
+
+// Logic analyzer: decoding the run-length entries gives back every level change
+static void test_analyzer_rle() {
+    run_check("analyzer entries decode to the sampled edges", [] {
+        set_timing(VESA_MODES[0], true, true);
+        g_analyzer.enabled = true;
+        g_analyzer.budget = (size_t)1 << 30;
+        const uint64_t cpp = (uint64_t)g_timing.clocks_per_pixel;
+
+        // Short runs, a run longer than one entry holds and a hand-over in between
+        std::vector<uint32_t> stream;
+        for (int i = 0; i < 5000; i++) {
+            uint32_t s = 0;
+            if (i % 800 < 96) s |= SAMPLE_H_SYNC;
+            if (i % 7 == 0) s |= 0xF800;
+            if (i % 13 < 2) s |= 0x07E0;
+            if (i > 4000) s |= SAMPLE_V_SYNC | 0x001F;
+            stream.push_back(s);
+        }
+        stream.insert(stream.end(), (size_t)ANALYZER_MAX_RUN * 2 + 77, stream.back());
+        stream.push_back(0);
+        stream.push_back(SAMPLE_H_SYNC);
+
+        uint64_t t0 = 1000;
+        main_time = 2 * t0;
+        std::vector<std::pair<uint64_t, uint16_t>> expected;
+        uint16_t prev = 0xFFFF;
+        uint16_t inputs = 0;
+        for (int i = 0; i < 5; i++) inputs |= (uint16_t)(1u << (LANE_RESET + i));
+        for (size_t i = 0; i < stream.size(); i++) {
+            uint32_t s = stream[i];
+            uint16_t levels = inputs | (s & SAMPLE_H_SYNC ? 1 << LANE_H_SYNC : 0) |
+                              (s & SAMPLE_V_SYNC ? 1 << LANE_V_SYNC : 0) | (s & 0xF800 ? 1 << LANE_RED : 0) |
+                              (s & 0x07E0 ? 1 << LANE_GREEN : 0) | (s & 0x001F ? 1 << LANE_BLUE : 0);
+            if (i > 0 && levels != prev) expected.push_back(std::make_pair(t0 + i * cpp, levels));
+            prev = levels;
+        }
+
+        size_t fed = 0;
+        while (fed < stream.size()) {
+            size_t n = std::min<size_t>(fed < 5000 ? 333 : 1 << 20, stream.size() - fed);
+            main_time = 2 * (t0 + (fed + n - 1) * cpp);
+            analyzer_feed(&stream[fed], n);
+            fed += n;
+            if (fed > 2000 && fed - n <= 2000) analyzer_hand_over();
+        }
+        analyzer_hand_over();
+
+        std::vector<std::pair<uint64_t, uint16_t>> decoded;
+        const LogicAnalyzer& a = g_analyzer;
+        for (const AnalyzerBlock& b : a.blocks) {
+            uint64_t t = b.start;
+            uint16_t levels = b.before;
+            for (uint32_t e : b.entries) {
+                t += analyzer_run(e) * b.clocks_per_pixel;
+                if (analyzer_levels(e) != levels) decoded.push_back(std::make_pair(t, analyzer_levels(e)));
+                levels = analyzer_levels(e);
+            }
+        }
+        if (a.blocks.size() < 2) return std::string("expected at least two blocks");
+        if (a.edges != expected.size()) {
+            return "counted " + std::to_string(a.edges) + " edges, expected " + std::to_string(expected.size());
+        }
+        if (decoded.size() != expected.size()) {
+            return "decoded " + std::to_string(decoded.size()) + " edges, expected " + std::to_string(expected.size());
+        }
+        for (size_t i = 0; i < decoded.size(); i++) {
+            if (decoded[i] != expected[i]) {
+                return "edge " + std::to_string(i) + " decodes to clock " + std::to_string(decoded[i].first) +
+                       ", expected " + std::to_string(expected[i].first);
+            }
+        }
+        return std::string();
+    });
+}
+
+// Button edges: gaps under MAX_INPUT_GAP_NS are kept in board clocks, longer
+// ones apply at once, and edges of one key stay a pixel apart
+static void test_input_schedule() {
+    run_check("input edges keep their wall-clock spacing", [] {
+        set_timing(VESA_MODES[0], true, true);    // 2 clocks per pixel
+        const int64_t MS = 1000000;
+        main_time = 2 * 1000;
+        g_input_queue.push({10 * MS, 1, 1});                  // B2 press
+        g_input_queue.push({15 * MS, 1, 0});                  // Released 5 ms later
+        apply_input_events();
+        if (keys[1].load() != 0) return std::string("the press was not applied at once");
+        uint64_t due = 1000 + 5 * BOARD_CLOCKS_PER_MS;
+        if (g_input_schedule.due != due) {
+            return "release due at " + std::to_string(g_input_schedule.due) + ", expected " + std::to_string(due);
+        }
+        if (input_batch_size(SAMPLE_BATCH) != SAMPLE_BATCH) return std::string("batch cut too early");
+        main_time = 2 * (due - 9);
+        if (input_batch_size(SAMPLE_BATCH) != 5) {
+            return "batch of " + std::to_string(input_batch_size(SAMPLE_BATCH)) + " pixels before the edge, expected 5";
+        }
+        apply_input_events();
+        if (keys[1].load() != 0) return std::string("the release was applied early");
+        main_time = 2 * due;
+        apply_input_events();
+        if (keys[1].load() != 1 || g_input_schedule.due != 0) return std::string("the release was not applied");
+
+        // After a pause longer than MAX_INPUT_GAP_NS the edge applies as soon as it is seen
+        g_input_queue.push({15 * MS + MAX_INPUT_GAP_NS, 2, 1});
+        apply_input_events();
+        if (keys[2].load() != 0) return std::string("an edge after a long gap waited");
+
+        // Same timestamp, same key: the release still lasts one pixel
+        g_input_queue.push({15 * MS + MAX_INPUT_GAP_NS, 2, 0});
+        apply_input_events();
+        if (keys[2].load() != 0 || g_input_schedule.due != due + 2) {
+            return "release of an instant tap due at " + std::to_string(g_input_schedule.due) +
+                   ", expected " + std::to_string(due + 2);
+        }
+        main_time += 4;
+        apply_input_events();
+        if (keys[2].load() != 1) return std::string("the instant tap was not released");
+
+        // Time going back (a rewind) forgets the schedule
+        main_time = 2 * 10;
+        g_input_queue.push({15 * MS + MAX_INPUT_GAP_NS + MS, 3, 1});
+        apply_input_events();
+        if (keys[3].load() != 0) return std::string("an edge after a rewind waited");
+        return std::string();
+    });
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0) {
+            g_verbose = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--verbose]\n";
+            return 2;
+        }
+    }
+    test_timing_detection();
+    test_frame_hashes();
+    test_sync_monitor();
+    test_exit_codes();
+    test_analyzer_rle();
+    test_input_schedule();
+    std::cout << "[SelfTest] " << (g_cases - g_failures) << " of " << g_cases << " checks passed" << std::endl;
+    return g_failures == 0 ? 0 : 1;
+}
@@ -4,7 +4,40 @@
 #include <atomic>
 #include <cstring>
 #include <chrono>
-#include "VDevelopmentBoard.h"            // from Verilating "display.v"
+#include <deque>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <cerrno>
+#include <cstdio>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <cxxabi.h>
+#endif
+#include <map>
+#include "design_plugin.h"                // C ABI of the design plugin (DevelopmentBoard)
 
 using namespace std;
 
@@ -13,9 +46,22 @@ static std::atomic<bool> g_quit_requested{false};
 static std::thread g_sim_thread;
 static std::atomic<bool> g_cleanup_done{false};  // Prevent reentrant cleanup
 
+// Process exit codes: 0 = success, 1 = startup failure, 2 = bad options,
+// 3..5 = the watchdog stopped a batch run (see check_watchdog()),
+// 6 = the design diverged from the --diff reference, 7 = a --pixel-check or
+// --strict-timing invariant failed
+const int EXIT_NO_H_SYNC = 3;
+const int EXIT_NO_V_SYNC = 4;
+const int EXIT_FROZEN = 5;
+const int EXIT_DIVERGED = 6;
+const int EXIT_CHECK_FAILED = 7;
+static std::atomic<int> g_exit_code{0};
+
 // SDL window and surfaces (forward declaration)
 static SDL_Window* g_window = nullptr;
 static SDL_Surface* g_vga_surface = nullptr;
+static const std::string WINDOW_TITLE =
+    "VGA and LED Simulator (SDL2) - Keys A/S/D/F/G = RESET/B2-B5, T = turbo, P = pause, ESC or Q to exit";
 
 // Cleanup function called on exit or window close
 void cleanup_simulation() {
@@ -47,13 +93,67 @@ void wait_10ns() {
     // No-op: simulation runs at full speed
 }
 
-VDevelopmentBoard* display;              // instantiation of the model
+static VgaDesignPorts g_ports = {};
+VgaDesignPorts* display = &g_ports;     // ports of the loaded design
 
 uint64_t main_time = 0;         // current simulation time
-double sc_time_stamp() {        // called by $time in Verilog
-    return main_time;
+
+// Simulation time as seen by the sampling side. With --pipeline the sampler
+// thread runs behind the model and uses the time stamp of its current batch.
+static bool g_pipelined = false;
+static uint64_t g_sampled_time = 0;     // Sampler thread only
+inline uint64_t sample_time() {
+    return g_pipelined ? g_sampled_time : main_time;
 }
 
+// Command line options (see parse_options() / --help)
+struct SimOptions {
+    bool latency_probe = false;     // --latency-probe: measure input-to-display latency
+    int autoclick_button = -1;      // --autoclick=B2: synthetic clicks on this button (-1 = off)
+    int autoclick_period_ms = 500;  // --autoclick-period=MS
+    int autoclick_hold_ms = 100;    // --autoclick-hold=MS
+    int autoclick_count = 0;        // --autoclick-count=N: quit after N clicks (0 = run until closed)
+    int sim_cpu = -1;               // --sim-cpu=N: pin the simulation thread (-1 = OS decides)
+    int render_cpu = -1;            // --render-cpu=N: pin the render/event thread
+    int sim_fifo_priority = 0;      // --sched=fifo[:PRIO]: SCHED_FIFO for the simulation thread (0 = off)
+    int sim_nice = 0;               // --nice=N: nice value for the simulation thread (0 = unchanged)
+    int timing_mode = -1;           // --mode=NAME: index into VESA_MODES (-1 = auto-detect)
+    int timing_report = 60;         // --timing-report=FRAMES: sync timing report interval (0 = off)
+    bool generic_sampler = false;   // --generic-sampler: never use the per-mode specialised sampler
+    int bench_sampler_frames = 0;   // --bench-sampler[=FRAMES]: benchmark the samplers and exit (0 = off)
+    bool headless = false;          // --headless: no window, simulate on the main thread
+    uint64_t frames = 0;            // --frames=N: exit after N frames (0 = run until closed)
+    int watchdog_ms = 200;          // --watchdog=MS: simulated time without sync edges before giving up (0 = off)
+    int watchdog_frames = 0;        // --watchdog-frames=N: batch runs fail after N identical frames (0 = off)
+    std::string design_path = "obj_dir/design.so";  // --design=PATH: design plugin to load
+    bool watch_design = false;      // --watch-design: reload the plugin whenever PATH changes
+    bool pipeline = false;          // --pipeline: evaluate and sample on separate threads
+    int sampler_cpu = -1;           // --sampler-cpu=N: pin the --pipeline sampler thread
+    std::string input_script;       // --input-script=FILE: press and release buttons at given frames
+    std::string profile_path;       // --profile=FILE: write CPU samples per function to FILE
+    int hash_every = 0;             // --hash-every=N: print the frame hash every N frames (0 = off)
+    std::string diff_path;          // --diff=PLUGIN: run this reference design in lockstep and compare
+    std::string diff_image = "diff_frame.ppm";  // --diff-image=FILE: heatmap written on divergence
+    int reference_cpu = -1;         // --reference-cpu=N: pin the --diff reference thread
+    std::string pixel_check;        // --pixel-check=FILE: per-frame pixel count invariants
+    bool strict_timing = false;     // --strict-timing: a timing report violation fails a batch run
+    bool turbo = false;             // --turbo[=N]: start in fast-forward mode
+    int turbo_every = 60;           // Frames per frame drawn in fast-forward mode (0 = none)
+    uint64_t turbo_until = 0;       // --turbo-until=FRAME: fast-forward without drawing up to FRAME
+    bool paused = false;            // --paused: pause once the design has started
+    uint64_t step_cycles = 1;       // --step-cycles=N: clock cycles per C key step
+    int watch_pixel_x = -1;         // --watch-pixel=X,Y: pixel for the X key (-1 = centre of the active area)
+    int watch_pixel_y = -1;
+    int run_until = 0;              // --run-until=COND: DebugCommand to start with (0 = none)
+    uint64_t run_until_arg = 0;
+    int checkpoint_every = 60;      // --checkpoint-every=FRAMES: rewind checkpoint interval (0 = off)
+    int checkpoint_mb = 256;        // --checkpoint-mb=MB: memory for rewind checkpoints
+    bool probe_per_line = false;    // --probe-every=line|frame: how often to sample the probes.txt signals
+    std::string probe_csv;          // --probe-csv=FILE: write every probe sample to FILE
+    int analyzer_mb = 0;            // --analyzer[=MB]: logic analyzer panel keeping up to MB of edges (0 = off)
+};
+static SimOptions g_options;
+
 // Window dimensions (initialized in main(), may differ from requested on HiDPI)
 int g_window_width = 800;
 int g_window_height = 600;
@@ -67,45 +167,91 @@ const int MARGIN = 20;          // Margin around display areas
 // SDL surfaces (declared above)
 static SDL_Surface* g_screen_surface = nullptr;      // Window surface (actual display)
 
-// 640X480 VGA sync parameters
-const int LEFT_PORCH        =     48;
-const int ACTIVE_WIDTH        =     640;
-const int RIGHT_PORCH        =     16;
-const int HORIZONTAL_SYNC    =    96;
-const int TOTAL_WIDTH        =    800;
+// VGA timing mode. Horizontal values are in pixels, vertical values in lines;
+// the active window starts at (h_sync + h_back, v_sync + v_back) counted from the
+// leading edge of the sync pulses.
+struct VgaTiming {
+    const char* name;
+    int h_active, h_front, h_sync, h_back;
+    int v_active, v_front, v_sync, v_back;
+    int clocks_per_pixel;   // clk (50 MHz) cycles per pixel
+    constexpr int h_total() const { return h_active + h_front + h_sync + h_back; }
+    constexpr int v_total() const { return v_active + v_front + v_sync + v_back; }
+    constexpr int h_start() const { return h_sync + h_back; }
+    constexpr int v_start() const { return v_sync + v_back; }
+};
+
+// VESA modes whose pixel clock is reachable from the 50 MHz board clock.
+// constexpr so sample_batch_fast<MODE> can specialise on each entry.
+static constexpr VgaTiming VESA_MODES[] = {
+    {"640x480@60", 640, 16,  96, 48, 480, 10, 2, 33, 2},   // 25 MHz (25.175 nominal)
+    {"640x400@70", 640, 16,  96, 48, 400, 12, 2, 35, 2},
+    {"640x350@70", 640, 16,  96, 48, 350, 37, 2, 60, 2},
+    {"800x600@72", 800, 56, 120, 64, 600, 37, 6, 23, 1},   // 50 MHz
+};
+const int NUM_VESA_MODES = sizeof(VESA_MODES) / sizeof(VESA_MODES[0]);
+
+// Framebuffer capacity; detected modes larger than this are clipped
+const int MAX_ACTIVE_WIDTH = 1280;
+const int MAX_ACTIVE_HEIGHT = 1024;
 
-const int TOP_PORCH            =     33;
-const int ACTIVE_HEIGHT        =     480;
-const int BOTTOM_PORCH        =     10;
-const int VERTICAL_SYNC        =    2;
-const int TOTAL_HEIGHT        =    525;
+// Current timing, owned by the simulation thread. Starts as 640x480@60 and is
+// replaced by detect_timing() (or --mode) before the first frame is sampled.
+static VgaTiming g_timing = VESA_MODES[0];
+static bool g_h_sync_polarity = true;   // Level of h_sync during the pulse
+static bool g_v_sync_polarity = true;   // Level of v_sync during the pulse
+static int H_ACTIVE_START = 144;        // Offsets of the active window from the sync edges
+static int V_ACTIVE_START = 35;
+static int ACTIVE_WIDTH = 640;          // Active window size clipped to the framebuffer
+static int ACTIVE_HEIGHT = 480;
+static int TOTAL_WIDTH = 800;
+static int TOTAL_HEIGHT = 525;
 
-// Active region offsets
-const int H_ACTIVE_START = 144; // H_SYNC(96) + H_BACK(40) + H_LEFT(8) from Verilog
-const int V_ACTIVE_START = 35;  // V_SYNC(2) + V_BACK(25) + V_TOP(8) from Verilog
+// Size of the frame in the swap buffer, published with it for the render thread
+static std::atomic<int> g_frame_width{640};
+static std::atomic<int> g_frame_height{480};
 
 // pixels are buffered here - double buffering for thread safety
-// 1D array layout: [x * ACTIVE_HEIGHT * 3 + y * 3 + channel]
-static float buffer_a[ACTIVE_WIDTH * ACTIVE_HEIGHT * 3] = {};
-static float buffer_b[ACTIVE_WIDTH * ACTIVE_HEIGHT * 3] = {};
+// RGB565 as produced by the design, row-major: [y * ACTIVE_WIDTH + x]
+static uint16_t buffer_a[MAX_ACTIVE_WIDTH * MAX_ACTIVE_HEIGHT] = {};
+static uint16_t buffer_b[MAX_ACTIVE_WIDTH * MAX_ACTIVE_HEIGHT] = {};
 
-// RGB565 to float lookup tables for fast conversion
-static float RGB5_TO_FLOAT[32];   // 5-bit (0-31) -> float (0.0-1.0)
-static float RGB6_TO_FLOAT[64];   // 6-bit (0-63) -> float (0.0-1.0)
+// RGB565 to SDL surface pixel lookup table (built by the render thread)
+static uint32_t RGB565_TO_SURFACE[65536];
 
-// Initialize RGB lookup tables
-void init_rgb_lookup_tables() {
-    for (int i = 0; i < 32; i++) {
-        RGB5_TO_FLOAT[i] = float(i) / 31.0f;
-    }
-    for (int i = 0; i < 64; i++) {
-        RGB6_TO_FLOAT[i] = float(i) / 63.0f;
+void init_rgb_lookup_table(const SDL_PixelFormat* format) {
+    for (int i = 0; i < 65536; i++) {
+        int r = (i >> 11) & 0x1F;
+        int g = (i >> 5) & 0x3F;
+        int b = i & 0x1F;
+        RGB565_TO_SURFACE[i] = SDL_MapRGB(format,
+            (Uint8)((r * 255 + 15) / 31), (Uint8)((g * 255 + 31) / 63), (Uint8)((b * 255 + 15) / 31));
     }
 }
-static std::atomic<float*> write_buffer{buffer_a};  // Simulation thread writes
-static std::atomic<float*> read_buffer{buffer_b};   // Render thread reads
+static std::atomic<uint16_t*> write_buffer{buffer_a};  // Simulation thread writes
+static std::atomic<uint16_t*> read_buffer{buffer_b};   // Render thread reads
 static std::atomic<bool> buffer_swap_pending{false}; // New frame ready flag
 
+// SDL user event posted by the simulation thread when a frame completes or the
+// LEDs change. g_frame_event_pending coalesces notifications so at most one is queued.
+static Uint32 g_frame_ready_event = (Uint32)-1;
+static std::atomic<bool> g_frame_event_pending{false};
+static std::atomic<uint64_t> g_published_frame{0};  // VSync count of the frame in the swap buffer
+
+// Wake the render thread; called from the simulation thread
+void notify_frame_ready() {
+    if (g_frame_ready_event == (Uint32)-1 ||
+        g_frame_event_pending.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    SDL_Event ev;
+    SDL_memset(&ev, 0, sizeof(ev));
+    ev.type = g_frame_ready_event;
+    if (SDL_PushEvent(&ev) != 1) {
+        g_frame_event_pending.store(false, std::memory_order_release);
+    }
+}
+
 std::atomic<bool> restart_triggered{false};
 
 // LED state variables
@@ -132,9 +278,12 @@ static int g_active_button = -1;
 
 // VSync counter for statistics
 static uint64_t g_vsync_count = 0;
+static uint64_t g_last_change_frame = 0;    // Last frame whose hash differed from the one before
+static bool g_check_failed = false;         // A --pixel-check / --strict-timing invariant failed
+static bool g_pixel_checks_armed = false;   // Off until the first full frame after a reset
 
 // Simple 5x3 bitmap font for labels (0 = empty, 1 = pixel)
-// Characters: V, G, A, L, E, D, 1, 2, 3, 4, 5, B, R, S, T
+// Characters: FONT_CHARS, in the order of the bitmaps
 const uint8_t FONT_5x3[][5] = {
     {0b10001, 0b10001, 0b01010, 0b01010, 0b00100}, // V (0)
     {0b01110, 0b10000, 0b10111, 0b10001, 0b01110}, // G (1)
@@ -151,30 +300,46 @@ const uint8_t FONT_5x3[][5] = {
     {0b11110, 0b10001, 0b11110, 0b10010, 0b10001}, // R (12)
     {0b01111, 0b10000, 0b01110, 0b00001, 0b11110}, // S (13)
     {0b11111, 0b00100, 0b00100, 0b00100, 0b00100}, // T (14)
+    {0b10001, 0b11001, 0b10101, 0b10011, 0b10001}, // N (15)
+    {0b01110, 0b10001, 0b10001, 0b10001, 0b01110}, // O (16)
+    {0b01110, 0b00100, 0b00100, 0b00100, 0b01110}, // I (17)
+    {0b01111, 0b10000, 0b10000, 0b10000, 0b01111}, // C (18)
+    {0b11111, 0b10000, 0b11110, 0b10000, 0b10000}, // F (19)
+    {0b10001, 0b10001, 0b11111, 0b10001, 0b10001}, // H (20)
+    {0b00111, 0b00010, 0b00010, 0b10010, 0b01100}, // J (21)
+    {0b10010, 0b10100, 0b11000, 0b10100, 0b10010}, // K (22)
+    {0b10001, 0b11011, 0b10101, 0b10001, 0b10001}, // M (23)
+    {0b11110, 0b10001, 0b11110, 0b10000, 0b10000}, // P (24)
+    {0b01110, 0b10001, 0b10101, 0b10010, 0b01101}, // Q (25)
+    {0b10001, 0b10001, 0b10001, 0b10001, 0b01110}, // U (26)
+    {0b10001, 0b10001, 0b10101, 0b11011, 0b10001}, // W (27)
+    {0b10001, 0b01010, 0b00100, 0b01010, 0b10001}, // X (28)
+    {0b10001, 0b01010, 0b00100, 0b00100, 0b00100}, // Y (29)
+    {0b11111, 0b00010, 0b00100, 0b01000, 0b11111}, // Z (30)
+    {0b01110, 0b10011, 0b10101, 0b11001, 0b01110}, // 0 (31)
+    {0b00111, 0b01000, 0b01110, 0b01001, 0b00110}, // 6 (32)
+    {0b01111, 0b00001, 0b00010, 0b00100, 0b00100}, // 7 (33)
+    {0b00110, 0b01001, 0b00110, 0b01001, 0b00110}, // 8 (34)
+    {0b00110, 0b01001, 0b00111, 0b00001, 0b01110}, // 9 (35)
+    {0b00000, 0b00000, 0b00000, 0b00000, 0b11111}, // _ (36)
+    {0b00000, 0b00000, 0b00000, 0b00000, 0b00100}, // . (37)
+    {0b00000, 0b00000, 0b01110, 0b00000, 0b00000}, // - (38)
+    {0b00000, 0b00100, 0b00000, 0b00100, 0b00000}, // : (39)
+    {0b00000, 0b01110, 0b00000, 0b01110, 0b00000}, // = (40)
+    {0b01100, 0b01000, 0b01000, 0b01000, 0b01100}, // [ (41)
+    {0b00110, 0b00010, 0b00010, 0b00010, 0b00110}, // ] (42)
+    {0b00000, 0b00100, 0b01110, 0b00100, 0b00000}, // + (43)
 };
+static const char FONT_CHARS[] = "VGALED12345BRSTNOICFHJKMPQUWXYZ06789_.-:=[]+";
+static_assert(sizeof(FONT_CHARS) - 1 == sizeof(FONT_5x3) / sizeof(FONT_5x3[0]),
+              "FONT_CHARS must list one character per FONT_5x3 bitmap");
 
+// Lower case letters are drawn as upper case; characters without a bitmap are blank
 void draw_char(SDL_Surface* surface, int x, int y, char c, uint32_t color, int scale) {
-    int idx = -1;
-    switch (c) {
-        case 'V': idx = 0; break;
-        case 'G': idx = 1; break;
-        case 'A': idx = 2; break;
-        case 'L': idx = 3; break;
-        case 'E': idx = 4; break;
-        case 'D': idx = 5; break;
-        case '1': idx = 6; break;
-        case '2': idx = 7; break;
-        case '3': idx = 8; break;
-        case '4': idx = 9; break;
-        case '5': idx = 10; break;
-        case 'B': idx = 11; break;
-        case 'R': idx = 12; break;
-        case 'S': idx = 13; break;
-        case 'T': idx = 14; break;
-    }
-    if (idx < 0) return;
-    
-    const uint8_t* bitmap = FONT_5x3[idx];
+    const char* found = c ? strchr(FONT_CHARS, toupper((unsigned char)c)) : nullptr;
+    if (!found) return;
+    
+    const uint8_t* bitmap = FONT_5x3[found - FONT_CHARS];
     for (int row = 0; row < 5; row++) {
         for (int col = 0; col < 5; col++) {  // 5 columns for 5x5 font (FONT_5x3 name is misleading)
             if (bitmap[row] & (1 << (4 - col))) {
@@ -194,11 +359,438 @@ void draw_label(SDL_Surface* surface, int x, int y, const char* text, uint32_t c
     }
 }
 
+// VSync count of the frame currently shown (render thread only)
+static uint64_t g_presented_frame = 0;
+
+// Set by the watchdog while the design produces no sync; shows "NO SIGNAL"
+static std::atomic<bool> g_no_signal{false};
+
+// Fast-forward mode (--turbo, T key): the sampler stores and publishes only
+// every --turbo'th frame, so the model runs at full speed. Off in batch runs
+// and with options that need every frame (g_turbo_allowed).
+static std::atomic<bool> g_turbo{false};
+static bool g_turbo_allowed = false;
+
+// Pause and step controls (P/N/L/C/E/X keys, --paused, --run-until). Commands
+// are posted from the render thread or main() into a one-entry mailbox; the
+// simulation thread picks them up between batches, so running flat out costs
+// one relaxed load per batch, and while paused it blocks on g_debug_wake.
+enum DebugCommand {
+    DEBUG_NONE,
+    DEBUG_PAUSE,            // Pause, or resume when paused
+    DEBUG_STEP_FRAME,       // Run to the start of the next frame
+    DEBUG_STEP_LINE,        // Run to the start of the next line
+    DEBUG_STEP_CYCLES,      // Run arg clock cycles (rounded up to whole pixels)
+    DEBUG_UNTIL_LED,        // Run until any LED changes
+    DEBUG_UNTIL_PIXEL,      // Run until the active-area pixel (arg >> 32, arg & 0xFFFFFFFF) changes
+    DEBUG_UNTIL_FRAME,      // Run until frame arg has started
+    DEBUG_UNTIL_CYCLE,      // Run until clock cycle arg
+    DEBUG_REWIND,           // Go back arg frames from the last finished one (see rewind_frames())
+};
+static std::mutex g_debug_mutex;
+static std::condition_variable g_debug_wake;
+static int g_debug_command = DEBUG_NONE;    // Guarded by g_debug_mutex
+static uint64_t g_debug_arg = 0;
+static std::atomic<bool> g_debug_pending{false};
+static std::atomic<bool> g_debug_paused{false};    // Shown in the window title
+
+void post_debug_command(int command, uint64_t arg) {
+    {
+        std::lock_guard<std::mutex> lock(g_debug_mutex);
+        g_debug_command = command;
+        g_debug_arg = arg;
+    }
+    g_debug_pending.store(true, std::memory_order_release);
+    g_debug_wake.notify_one();
+}
+
+// DEBUG_UNTIL_PIXEL argument for --watch-pixel; the simulation thread maps
+// the -1 default to the centre of the active area
+uint64_t watch_pixel_arg() {
+    return ((uint64_t)(uint32_t)g_options.watch_pixel_x << 32) | (uint32_t)g_options.watch_pixel_y;
+}
+
+// Internal signal probes (probes.txt, see run_simulation.sh): the simulation
+// thread reads them through the plugin once per frame or line (--probe-every)
+// between batches and keeps the last PROBE_HISTORY samples, which the render
+// thread plots beside the VGA area. Nothing is read when there are no probes.
+const size_t PROBE_HISTORY = 4096;
+const int PROBE_PANEL_WIDTH = 300;      // Window points added for the plot panel
+struct SignalProbes {
+    size_t count = 0;                   // Simulation thread only
+    uint64_t last_frame = ~0ULL;        // Frame and line of the last sample (simulation thread)
+    int last_line = -1;
+    std::ofstream csv;                  // --probe-csv (simulation thread)
+    std::vector<std::string> csv_names; // Columns of the last CSV header written
+    uint64_t csv_rows = 0;
+    std::vector<uint64_t> scratch;      // read_probes() target
+    
+    std::mutex mutex;                   // Guards the names and the ring below
+    std::vector<std::string> names;
+    std::vector<uint64_t> values;       // PROBE_HISTORY rows of names.size() values
+    std::vector<uint64_t> frames;       // Frame of each row
+    uint64_t samples = 0;               // Rows written; the newest is (samples - 1) % PROBE_HISTORY
+    size_t filled = 0;                  // Valid rows, up to PROBE_HISTORY
+};
+static SignalProbes g_signal_probes;
+static int g_probe_panel_width = 0;     // Surface pixels, set by main() when the design has probes
+
+// Plot panel: per probe its name, latest value and the last samples scaled
+// to their range, newest on the right, one sample per pixel (render thread)
+void draw_probe_panel(const SDL_Rect& area, int scale, uint32_t label_color) {
+    SignalProbes& p = g_signal_probes;
+    std::vector<std::string> names;
+    std::vector<uint64_t> rows;         // Oldest first
+    size_t n = 0;
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        names = p.names;
+        n = std::min(p.filled, (size_t)std::max(area.w, 1));
+        for (size_t r = 0; r < n; r++) {
+            size_t slot = (size_t)((p.samples - n + r) % PROBE_HISTORY);
+            rows.insert(rows.end(), p.values.begin() + slot * names.size(),
+                        p.values.begin() + (slot + 1) * names.size());
+        }
+    }
+    if (names.empty()) return;
+    
+    SDL_PixelFormat* fmt = g_screen_surface->format;
+    uint32_t plot_bg = SDL_MapRGB(fmt, 35, 35, 35);
+    uint32_t trace = SDL_MapRGB(fmt, 0, 200, 0);
+    int text_h = 5 * scale;
+    int char_w = 6 * scale;
+    int row_h = std::max(area.h / (int)names.size(), text_h * 4);
+    int shown = std::min((int)names.size(), std::max(1, area.h / row_h));
+    for (int i = 0; i < shown; i++) {
+        int y = area.y + i * row_h;
+        // Name and latest value; long names keep their end, the signal itself
+        std::string value = n > 0 ? std::to_string((unsigned long long)rows[(n - 1) * names.size() + i]) : "-";
+        int max_chars = std::max(1, area.w / char_w - (int)value.size() - 1);
+        std::string name = names[i];
+        if ((int)name.size() > max_chars) {
+            name = name.substr(name.size() - max_chars);
+        }
+        draw_label(g_screen_surface, area.x, y, (name + " " + value).c_str(), label_color, scale);
+        
+        SDL_Rect plot = {area.x, y + text_h + 4, area.w, row_h - text_h - 4 - MARGIN / 2};
+        SDL_FillRect(g_screen_surface, &plot, plot_bg);
+        if (n == 0 || plot.h < 2) continue;
+        uint64_t lo = ~0ULL, hi = 0;
+        for (size_t r = 0; r < n; r++) {
+            lo = std::min(lo, rows[r * names.size() + i]);
+            hi = std::max(hi, rows[r * names.size() + i]);
+        }
+        int prev_y = -1;
+        for (size_t r = 0; r < n; r++) {
+            uint64_t v = rows[r * names.size() + i];
+            int py = plot.y + plot.h / 2;
+            if (hi > lo) {
+                py = plot.y + plot.h - 1 - (int)((double)(v - lo) / (double)(hi - lo) * (plot.h - 1));
+            }
+            int top = prev_y < 0 ? py : std::min(py, prev_y);
+            int bottom = prev_y < 0 ? py : std::max(py, prev_y);
+            SDL_Rect dot = {plot.x + plot.w - (int)n + (int)r, top, 1, bottom - top + 1};
+            SDL_FillRect(g_screen_surface, &dot, trace);
+            prev_y = py;
+        }
+    }
+}
+
+// Logic analyzer (--analyzer): the simulation thread looks at every pixel
+// sample (one per pixel clock) for h_sync, v_sync, whether each colour channel
+// is lit and the reset and button inputs, and stores only the changes. Each
+// entry packs the pixel clocks since the previous entry above the new levels.
+// Entries fill blocks of about one frame, which are handed to the render
+// thread at frame ends and pauses; the oldest blocks go beyond --analyzer=MB.
+enum AnalyzerLane {
+    LANE_H_SYNC, LANE_V_SYNC, LANE_RED, LANE_GREEN, LANE_BLUE,
+    LANE_RESET, LANE_B2, LANE_B3, LANE_B4, LANE_B5, ANALYZER_LANES
+};
+static const char* const ANALYZER_LANE_NAMES[ANALYZER_LANES] = {
+    "HSYNC", "VSYNC", "R", "G", "B", "RESET", "B2", "B3", "B4", "B5"
+};
+const uint32_t ANALYZER_MAX_RUN = (1u << (32 - ANALYZER_LANES)) - 1;  // Longest run of one entry, in pixels
+const size_t ANALYZER_BLOCK_ENTRIES = 1 << 16;
+const int ANALYZER_PANEL_HEIGHT = 300;      // Window points added below the buttons
+const uint64_t ANALYZER_MIN_SPAN = 32;      // Board clocks across the panel, zoomed in fully
+const uint64_t ANALYZER_MAX_SPAN = 1 << 22; // About five 640x480 frames
+const uint64_t ANALYZER_DEFAULT_SPAN = 3200;    // Two 640x480 lines
+const uint64_t BOARD_CLOCKS_PER_MS = 50000;     // 50 MHz board clock
+
+struct AnalyzerBlock {
+    uint64_t start = 0;             // Board clock of the first entry
+    int clocks_per_pixel = 1;
+    uint16_t before = 0;            // Levels before the first entry
+    std::vector<uint32_t> entries;  // run << ANALYZER_LANES | levels, run in pixels since the last entry
+};
+
+struct LogicAnalyzer {
+    bool enabled = false;           // --analyzer, set by main()
+    size_t budget = 0;              // --analyzer=MB, in bytes
+    
+    // Simulation thread (the sampler thread with --pipeline)
+    AnalyzerBlock open;             // Block being filled
+    bool started = false;
+    uint16_t levels = 0;            // Levels of the last sample
+    uint64_t last = 0;              // Board clock of the last sample
+    uint64_t last_entry = 0;        // Board clock of the last entry
+    uint64_t handed_frame = 0;      // g_vsync_count and board clock at the last hand-over
+    uint64_t handed_time = 0;
+    uint64_t first = 0;             // Board clock of the first sample, for the final report
+    uint64_t edges = 0;
+    
+    std::mutex mutex;               // Guards the blocks and the fields below
+    std::deque<AnalyzerBlock> blocks;
+    uint64_t end = 0;               // Board clock of the last handed-over sample
+    size_t bytes = 0;
+};
+static LogicAnalyzer g_analyzer;
+static int g_analyzer_panel_height = 0;     // Surface pixels, set by main() with --analyzer
+
+// What the panel shows (render thread only)
+struct AnalyzerView {
+    uint64_t span = ANALYZER_DEFAULT_SPAN;  // Board clocks across the waves
+    uint64_t pan = 0;               // How far the view lies before the newest data (or the trigger)
+    int trigger = -1;               // Lane to trigger on (-1 = free running)
+    bool rising = true;
+    bool cursor_set[2] = {false, false};
+    int64_t cursor[2] = {0, 0};     // Measurement cursors A and B, board clocks from the reference
+    uint64_t reference = 0;         // Newest data, or the trigger point plus 7/8 span
+    SDL_Rect waves = {0, 0, 0, 0};  // Layout of the last draw, for the mouse
+    SDL_Rect labels = {0, 0, 0, 0};
+    int lane_h = 1;
+    uint64_t left = 0;              // Board clock at the left edge of the last draw
+};
+static AnalyzerView g_analyzer_view;
+
+// Fields of a block entry
+inline uint64_t analyzer_run(uint32_t entry) { return entry >> ANALYZER_LANES; }
+inline uint16_t analyzer_levels(uint32_t entry) { return (uint16_t)(entry & ((1u << ANALYZER_LANES) - 1)); }
+
+// Newest edge of the trigger lane that leaves room for the view after it (mutex held)
+bool find_trigger(uint64_t latest, uint64_t& at) {
+    const LogicAnalyzer& a = g_analyzer;
+    const AnalyzerView& v = g_analyzer_view;
+    uint16_t bit = (uint16_t)(1u << v.trigger);
+    int searched = 0;
+    for (size_t b = a.blocks.size(); b-- > 0 && searched++ < 64;) {
+        const AnalyzerBlock& block = a.blocks[b];
+        uint64_t t = block.start;
+        uint16_t levels = block.before;
+        bool found = false;
+        for (size_t k = 0; k < block.entries.size(); k++) {
+            t += analyzer_run(block.entries[k]) * block.clocks_per_pixel;
+            if (t > latest) break;
+            uint16_t next = analyzer_levels(block.entries[k]);
+            if ((levels ^ next) & bit && ((next & bit) != 0) == v.rising) {
+                at = t;
+                found = true;
+            }
+            levels = next;
+        }
+        if (found) return true;
+    }
+    return false;
+}
+
+// Panel below the buttons: one lane per signal, time running to the right.
+// Columns holding an edge are drawn as a full-height stroke, so a frame-wide
+// view still shows where the activity is; zoomed in far enough, the pixel
+// clocks get grid lines (render thread).
+void draw_analyzer(const SDL_Rect& area, int scale, uint32_t label_color) {
+    LogicAnalyzer& a = g_analyzer;
+    AnalyzerView& v = g_analyzer_view;
+    SDL_PixelFormat* fmt = g_screen_surface->format;
+    int text_h = 5 * scale;
+    int char_w = 6 * scale;
+    SDL_FillRect(g_screen_surface, &area, SDL_MapRGB(fmt, 30, 30, 30));
+    
+    v.labels = {area.x, area.y + text_h + 8, char_w * 6, area.h - text_h - 8};
+    v.waves = {v.labels.x + v.labels.w, v.labels.y, area.w - v.labels.w, v.labels.h};
+    v.lane_h = std::max(1, v.waves.h / ANALYZER_LANES);
+    int w = v.waves.w;
+    if (w <= 0) return;
+    
+    std::vector<uint16_t> col_levels(w, 0), col_edges(w, 0);
+    int data_from = w, data_to = 0;
+    int cpp = 1;
+    bool triggered = false;
+    uint64_t trigger_at = 0;
+    {
+        std::lock_guard<std::mutex> lock(a.mutex);
+        if (!a.blocks.empty()) {
+            cpp = a.blocks.back().clocks_per_pixel;
+            v.reference = a.end;
+            if (v.trigger >= 0 && a.end > v.span) {
+                triggered = find_trigger(a.end - v.span * 7 / 8, trigger_at);
+                if (triggered) v.reference = trigger_at + v.span * 7 / 8;
+            }
+            uint64_t right = v.reference > v.pan ? v.reference - v.pan : 0;
+            v.left = right > v.span ? right - v.span : 0;
+            
+            // Last block starting at or before the left edge, then walk forwards
+            size_t b = 0;
+            while (b + 1 < a.blocks.size() && a.blocks[b + 1].start <= v.left) b++;
+            uint16_t levels = a.blocks[b].before;
+            int col = 0;
+            if (a.blocks[b].start > v.left) {
+                col = (int)((a.blocks[b].start - v.left) * w / v.span);
+            }
+            data_from = std::min(col, w);
+            for (; b < a.blocks.size(); b++) {
+                const AnalyzerBlock& block = a.blocks[b];
+                uint64_t t = block.start;
+                for (size_t k = 0; k < block.entries.size(); k++) {
+                    t += analyzer_run(block.entries[k]) * block.clocks_per_pixel;
+                    uint16_t next = analyzer_levels(block.entries[k]);
+                    if (t >= v.left) {
+                        if (t >= v.left + v.span) break;
+                        int c = (int)((t - v.left) * w / v.span);
+                        for (; col < c; col++) col_levels[col] = levels;
+                        col_edges[c] |= levels ^ next;
+                    }
+                    levels = next;
+                }
+            }
+            data_to = a.end >= v.left ? (int)std::min<uint64_t>(w, (a.end - v.left) * w / v.span + 1) : 0;
+            for (; col < data_to; col++) col_levels[col] = levels;
+        }
+    }
+    
+    // Header: zoom, trigger and the cursor measurement
+    std::ostringstream head;
+    head << "SPAN " << v.span << " CLK";
+    if (v.trigger >= 0) {
+        head << "  TRIG " << ANALYZER_LANE_NAMES[v.trigger] << (v.rising ? " RISE" : " FALL")
+             << (triggered ? "" : " WAIT");
+    }
+    if (v.cursor_set[0] && v.cursor_set[1]) {
+        uint64_t d = (uint64_t)std::abs(v.cursor[0] - v.cursor[1]);
+        char us[32];
+        snprintf(us, sizeof(us), "%.2f", d * 1000.0 / BOARD_CLOCKS_PER_MS);
+        head << "  A-B " << d << " CLK " << d / cpp << " PX " << us << " US";
+    }
+    draw_label(g_screen_surface, area.x, area.y + 4, head.str().c_str(), label_color, scale);
+    
+    // Pixel clock grid once a pixel is at least four columns wide
+    if (v.span / cpp * 4 <= (uint64_t)w) {
+        uint32_t grid = SDL_MapRGB(fmt, 45, 45, 45);
+        for (uint64_t t = v.left - v.left % cpp; t < v.left + v.span; t += cpp) {
+            if (t < v.left) continue;
+            SDL_Rect line = {v.waves.x + (int)((t - v.left) * w / v.span), v.waves.y, 1, v.waves.h};
+            SDL_FillRect(g_screen_surface, &line, grid);
+        }
+    }
+    
+    const uint32_t lane_colors[ANALYZER_LANES] = {
+        SDL_MapRGB(fmt, 230, 200, 0), SDL_MapRGB(fmt, 230, 200, 0), SDL_MapRGB(fmt, 255, 60, 60),
+        SDL_MapRGB(fmt, 60, 220, 60), SDL_MapRGB(fmt, 80, 120, 255), SDL_MapRGB(fmt, 0, 200, 200),
+        SDL_MapRGB(fmt, 0, 200, 200), SDL_MapRGB(fmt, 0, 200, 200), SDL_MapRGB(fmt, 0, 200, 200),
+        SDL_MapRGB(fmt, 0, 200, 200),
+    };
+    uint32_t trigger_color = SDL_MapRGB(fmt, 255, 255, 255);
+    for (int lane = 0; lane < ANALYZER_LANES; lane++) {
+        int top = v.waves.y + lane * v.lane_h;
+        int high = top + v.lane_h / 5;
+        int low = top + v.lane_h * 4 / 5;
+        draw_label(g_screen_surface, area.x, top + (v.lane_h - text_h) / 2, ANALYZER_LANE_NAMES[lane],
+                   lane == v.trigger ? trigger_color : label_color, scale);
+        uint16_t bit = (uint16_t)(1u << lane);
+        // Runs of equal level become one rectangle; edges a full-height stroke
+        int run_start = data_from;
+        for (int c = data_from; c <= data_to && c <= w; c++) {
+            bool edge = c < data_to && (col_edges[c] & bit);
+            bool level_change = c < data_to && c > run_start && ((col_levels[c] ^ col_levels[c - 1]) & bit);
+            if (c == data_to || edge || level_change) {
+                if (c > run_start) {
+                    int y = (col_levels[run_start] & bit) ? high : low;
+                    SDL_Rect line = {v.waves.x + run_start, y, c - run_start, 1};
+                    SDL_FillRect(g_screen_surface, &line, lane_colors[lane]);
+                }
+                run_start = c;
+                if (edge) {
+                    SDL_Rect stroke = {v.waves.x + c, high, 1, low - high + 1};
+                    SDL_FillRect(g_screen_surface, &stroke, lane_colors[lane]);
+                    run_start = c + 1;
+                }
+            }
+        }
+    }
+    
+    // Trigger point and cursors
+    if (triggered && trigger_at >= v.left && trigger_at < v.left + v.span) {
+        SDL_Rect mark = {v.waves.x + (int)((trigger_at - v.left) * w / v.span), v.waves.y - 6, 1, 6};
+        SDL_FillRect(g_screen_surface, &mark, trigger_color);
+    }
+    const uint32_t cursor_colors[2] = {SDL_MapRGB(fmt, 255, 140, 0), SDL_MapRGB(fmt, 200, 100, 255)};
+    for (int i = 0; i < 2; i++) {
+        uint64_t t = v.reference + v.cursor[i];
+        if (v.cursor_set[i] && t >= v.left && t < v.left + v.span) {
+            SDL_Rect line = {v.waves.x + (int)((t - v.left) * w / v.span), v.waves.y, 1, v.waves.h};
+            SDL_FillRect(g_screen_surface, &line, cursor_colors[i]);
+        }
+    }
+}
+
+// Mouse on the analyzer panel: a click on a lane name cycles its trigger
+// (rising, falling, off), left and right clicks on the waves place cursors A
+// and B. The cursors keep their distance from the trigger point (or the
+// newest data), so they stay on a triggered waveform. Returns false if the
+// click was elsewhere (render thread).
+bool analyzer_click(int x, int y, int button) {
+    AnalyzerView& v = g_analyzer_view;
+    if (!g_analyzer.enabled || y < v.labels.y || y >= v.labels.y + v.labels.h) return false;
+    int lane = (y - v.labels.y) / v.lane_h;
+    if (x >= v.labels.x && x < v.labels.x + v.labels.w && lane < ANALYZER_LANES) {
+        if (v.trigger != lane) {
+            v.trigger = lane;
+            v.rising = true;
+        } else if (v.rising) {
+            v.rising = false;
+        } else {
+            v.trigger = -1;
+        }
+        v.pan = 0;
+        return true;
+    }
+    if (x >= v.waves.x && x < v.waves.x + v.waves.w && v.waves.w > 0) {
+        uint64_t t = v.left + ((uint64_t)(x - v.waves.x) * v.span + v.waves.w / 2) / v.waves.w;
+        int i = button == SDL_BUTTON_RIGHT ? 1 : 0;
+        v.cursor[i] = (int64_t)(t - v.reference);
+        v.cursor_set[i] = true;
+        return true;
+    }
+    return false;
+}
+
+// Zoom by a power of two; the trigger point (or the newest data) keeps its place
+void analyzer_zoom(bool in) {
+    AnalyzerView& v = g_analyzer_view;
+    uint64_t span = in ? std::max(ANALYZER_MIN_SPAN, v.span / 2) : std::min(ANALYZER_MAX_SPAN, v.span * 2);
+    v.pan = v.pan * span / v.span;
+    v.span = span;
+}
+
+// Move the view by a quarter of its width; it never goes past the newest data
+void analyzer_pan(bool back) {
+    AnalyzerView& v = g_analyzer_view;
+    uint64_t step = std::max<uint64_t>(1, v.span / 4);
+    v.pan = back ? v.pan + step : (v.pan > step ? v.pan - step : 0);
+}
+
+// Let keyboard_event_watch() see key edges between the drawing steps of
+// render_sdl(), instead of only once the whole redraw is done
+inline void pump_input() {
+    SDL_PumpEvents();
+}
+
 // SDL2 render function - replaces OpenGL/GLUT render
 void render_sdl() {
     // 1. Check and swap double buffer
-    if (buffer_swap_pending.exchange(false, std::memory_order_acquire)) {
-        float* old_write = write_buffer.exchange(
+    bool swapped = buffer_swap_pending.exchange(false, std::memory_order_acquire);
+    if (swapped) {
+        g_presented_frame = g_published_frame.load(std::memory_order_relaxed);
+        uint16_t* old_write = write_buffer.exchange(
             read_buffer.exchange(
                 write_buffer.load(std::memory_order_relaxed),
                 std::memory_order_relaxed
@@ -208,52 +800,64 @@ void render_sdl() {
         (void)old_write;
     }
     
-    // 2. Convert float RGB to SDL surface pixels (handle layout: x-major -> y-major)
-    float* src_buf = read_buffer.load(std::memory_order_acquire);
-    SDL_LockSurface(g_vga_surface);
-    uint32_t* dst_pixels = (uint32_t*)g_vga_surface->pixels;
-    
-    for (int y = 0; y < ACTIVE_HEIGHT; y++) {
-        for (int x = 0; x < ACTIVE_WIDTH; x++) {
-            // Source buffer: x-major [x * HEIGHT + y]
-            int src_idx = ((x * ACTIVE_HEIGHT) + y) * 3;
-            // SDL surface: y-major [y * WIDTH + x]
-            int dst_idx = y * ACTIVE_WIDTH + x;
-            
-            uint8_t r = (uint8_t)(src_buf[src_idx] * 255.0f);
-            uint8_t g = (uint8_t)(src_buf[src_idx + 1] * 255.0f);
-            uint8_t b = (uint8_t)(src_buf[src_idx + 2] * 255.0f);
-            
-            dst_pixels[dst_idx] = SDL_MapRGB(g_vga_surface->format, r, g, b);
+    // 2. Convert RGB565 to SDL surface pixels, resizing the surface if the mode changed
+    //    Skipped when only the LEDs/buttons changed; the surface still holds the last frame
+    if (swapped) {
+        int frame_w = g_frame_width.load(std::memory_order_relaxed);
+        int frame_h = g_frame_height.load(std::memory_order_relaxed);
+        if (g_vga_surface->w != frame_w || g_vga_surface->h != frame_h) {
+            SDL_Surface* resized = SDL_CreateRGBSurfaceWithFormat(0, frame_w, frame_h,
+                32, SDL_PIXELFORMAT_RGB888);
+            if (resized) {
+                SDL_FreeSurface(g_vga_surface);
+                g_vga_surface = resized;
+                std::cerr << "[Render] VGA surface resized to " << frame_w << "x" << frame_h << "\n";
+            }
+        }
+        const uint16_t* src_buf = read_buffer.load(std::memory_order_acquire);
+        int w = std::min(frame_w, g_vga_surface->w);
+        int h = std::min(frame_h, g_vga_surface->h);
+        
+        SDL_LockSurface(g_vga_surface);
+        for (int y = 0; y < h; y++) {
+            const uint16_t* src_row = src_buf + y * frame_w;
+            uint32_t* dst_row = (uint32_t*)((uint8_t*)g_vga_surface->pixels + y * g_vga_surface->pitch);
+            for (int x = 0; x < w; x++) {
+                dst_row[x] = RGB565_TO_SURFACE[src_row[x]];
+            }
         }
+        SDL_UnlockSurface(g_vga_surface);
+        pump_input();
     }
-    SDL_UnlockSurface(g_vga_surface);
     
     // 3. Clear screen background
     SDL_FillRect(g_screen_surface, NULL, 
         SDL_MapRGB(g_screen_surface->format, 25, 25, 25));
     
-    // Calculate font scale based on window height (min scale = 2)
-    int font_scale = g_window_height / 200;
+    // Calculate font scale based on window height (min scale = 2); the
+    // logic analyzer, if any, takes the bottom of the window
+    int layout_h = g_window_height - g_analyzer_panel_height;
+    int font_scale = layout_h / 200;
     if (font_scale < 2) font_scale = 2;
     int font_height = 5 * font_scale;  // 5 rows * scale
     
-    // 4. Calculate VGA display area (scale to fit, maintain 4:3 aspect ratio)
+    // 4. Calculate VGA display area (scale to fit, maintain the mode's aspect ratio)
     // Leave space for: label (MARGIN_TOP) + VGA area + margin + LED area
     int vga_top = MARGIN_TOP + font_height + 5;  // VGA area starts below label
-    int available_height = g_window_height - vga_top - LED_AREA_HEIGHT - MARGIN;
-    int vga_display_w = g_window_width - MARGIN * 2;  // Available width (minus margins)
-    int vga_display_h = vga_display_w * 3 / 4;        // Maintain 4:3 aspect ratio
+    int available_height = layout_h - vga_top - LED_AREA_HEIGHT - MARGIN;
+    int panel_w = g_probe_panel_width;  // Probe plots on the right, if any
+    int vga_display_w = g_window_width - panel_w - MARGIN * 2;  // Available width (minus margins)
+    int vga_display_h = vga_display_w * g_vga_surface->h / g_vga_surface->w;  // Maintain aspect ratio
     
     // If height exceeds available space, scale based on height instead
     if (vga_display_h > available_height) {
         vga_display_h = available_height;
-        vga_display_w = vga_display_h * 4 / 3;
+        vga_display_w = vga_display_h * g_vga_surface->w / g_vga_surface->h;
     }
     
     // Center the display
     SDL_Rect vga_rect = {
-        (g_window_width - vga_display_w) / 2,
+        (g_window_width - panel_w - vga_display_w) / 2,
         vga_top,
         vga_display_w,
         vga_display_h
@@ -262,9 +866,27 @@ void render_sdl() {
     // 5. Scale and blit VGA area (single blit replaces 300k+ draw calls)
     SDL_BlitScaled(g_vga_surface, NULL, g_screen_surface, &vga_rect);
     
+    // Like a monitor, blank the picture and say so when the sync is gone
+    if (g_no_signal.load(std::memory_order_relaxed)) {
+        SDL_FillRect(g_screen_surface, &vga_rect, SDL_MapRGB(g_screen_surface->format, 0, 0, 0));
+        const char* text = "NO SIGNAL";
+        int text_scale = font_scale * 2;
+        int text_w = (int)strlen(text) * 6 * text_scale - text_scale;
+        draw_label(g_screen_surface, vga_rect.x + (vga_rect.w - text_w) / 2,
+                   vga_rect.y + (vga_rect.h - 5 * text_scale) / 2, text,
+                   SDL_MapRGB(g_screen_surface->format, 255, 255, 255), text_scale);
+    }
+    
     // Draw VGA label (in the top margin area)
     uint32_t label_color = SDL_MapRGB(g_screen_surface->format, 200, 200, 200);
     draw_label(g_screen_surface, vga_rect.x, MARGIN_TOP, "VGA", label_color, font_scale);
+    if (panel_w > 0) {
+        int panel_x = g_window_width - panel_w;
+        draw_label(g_screen_surface, panel_x, MARGIN_TOP, "PROBES", label_color, font_scale);
+        SDL_Rect panel = {panel_x, vga_top, panel_w - MARGIN, vga_rect.h};
+        draw_probe_panel(panel, std::max(2, font_scale / 2), label_color);
+    }
+    pump_input();
     
     // 6. Draw LED area (below VGA display)
     int led_y_start = vga_rect.y + vga_rect.h + MARGIN;
@@ -302,13 +924,13 @@ void render_sdl() {
         int label_x = cx - label_led_w / 2;
         draw_label(g_screen_surface, label_x, label_y, "LED", label_color, label_font_scale);
         // Draw digit (1-5) - position after "LED"
-        char digit_str[2] = {'1' + i, '\0'};
+        char digit_str[2] = {(char)('1' + i), '\0'};
         draw_label(g_screen_surface, label_x + 3 * label_char_w, label_y, digit_str, label_color, label_font_scale);
     }
     
     // 8. Draw virtual button area (below LED area)
     int button_y_start = led_y_start + LED_AREA_HEIGHT + MARGIN;
-    int button_area_h = g_window_height - button_y_start - MARGIN;
+    int button_area_h = layout_h - button_y_start - MARGIN;
     if (button_area_h < 60) button_area_h = 60;
     
     // Button area background
@@ -364,152 +986,644 @@ void render_sdl() {
         draw_label(g_screen_surface, text_x, text_y, g_buttons[i].label, text_color, btn_text_scale);
     }
     
-    // 9. Update window
+    // 9. Logic analyzer (below the buttons)
+    if (g_analyzer_panel_height > 0) {
+        pump_input();
+        SDL_Rect panel = {MARGIN, button_y_start + button_area_h + MARGIN, g_window_width - MARGIN * 2,
+                          g_window_height - button_y_start - button_area_h - MARGIN * 2};
+        draw_analyzer(panel, std::max(2, font_scale / 2), label_color);
+        pump_input();
+    }
+    
+    // 10. Update window
     SDL_UpdateWindowSurface(g_window);
 }
 
 // handle up/down/left/right arrow keys
 std::atomic<int> keys[5] = {{1}, {1}, {1}, {1}, {1}}; // Initialized to inactive state
 
+// Single-producer/single-consumer lock-free ring (capacity N - 1, N power of two)
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert((N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+public:
+    bool push(const T& item) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t next = (head + 1) & (N - 1);
+        if (next == m_tail.load(std::memory_order_acquire)) {
+            return false;  // Full
+        }
+        m_items[head] = item;
+        m_head.store(next, std::memory_order_release);
+        return true;
+    }
+    bool peek(T& item) const {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;  // Empty
+        }
+        item = m_items[tail];
+        return true;
+    }
+    void pop() {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        m_tail.store((tail + 1) & (N - 1), std::memory_order_release);
+    }
+private:
+    T m_items[N];
+    alignas(64) std::atomic<size_t> m_head{0};  // Written by producer
+    alignas(64) std::atomic<size_t> m_tail{0};  // Written by consumer
+};
+
+// Button edge produced by the render thread and applied by the simulation thread
+struct InputEvent {
+    int64_t wall_ns;      // steady_clock time the event entered SDL's queue
+    uint8_t key_index;    // Index in keys[] array
+    uint8_t pressed;      // 1 = pressed (signal low), 0 = released
+};
+
+static SpscQueue<InputEvent, 256> g_input_queue;
+static std::deque<InputEvent> g_input_backlog;  // Render thread only: events waiting for queue space
+
+// Input latency statistics (written by simulation thread, reported by render thread)
+static std::atomic<uint64_t> g_input_applied{0};
+static std::atomic<uint64_t> g_input_latency_sum_ns{0};
+static std::atomic<uint64_t> g_input_latency_max_ns{0};
+
+static int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Queue a button edge for the simulation thread; sdl_timestamp is the SDL event time (ms)
+void post_input(int key_index, bool pressed, Uint32 sdl_timestamp) {
+    // Back-date the wall time by the age of the SDL event so latency covers SDL queueing too
+    Uint32 age_ms = SDL_GetTicks() - sdl_timestamp;
+    if (age_ms > 1000) age_ms = 0;  // Synthetic or stale timestamp
+    InputEvent ev;
+    ev.wall_ns = steady_now_ns() - (int64_t)age_ms * 1000000;
+    ev.key_index = (uint8_t)key_index;
+    ev.pressed = pressed ? 1 : 0;
+    // Preserve ordering: never overtake events already waiting in the backlog
+    if (!g_input_backlog.empty() || !g_input_queue.push(ev)) {
+        g_input_backlog.push_back(ev);
+    }
+}
+
+// Move backlogged events into the queue once the simulation thread has made room
+void flush_input_backlog() {
+    while (!g_input_backlog.empty() && g_input_queue.push(g_input_backlog.front())) {
+        g_input_backlog.pop_front();
+    }
+}
+
+// Input-to-display latency probe (--latency-probe). One measurement is in flight
+// at a time: the simulation thread arms it when an edge is applied and marks the
+// first frame (or LED update) that differs; the render thread stamps its presentation.
+// Under --pipeline the edge is applied on the eval thread, and the sampler takes
+// the baseline frame hash once it has caught up with the edge (PROBE_ARMED).
+enum { PROBE_IDLE = 0, PROBE_WAIT_CHANGE = 1, PROBE_WAIT_PRESENT = 2, PROBE_ARMED = 3 };
+struct LatencyProbe {
+    std::atomic<int> state{PROBE_IDLE};
+    int64_t input_wall_ns = 0;      // When the event entered SDL
+    int64_t apply_wall_ns = 0;      // When the simulation thread applied it
+    uint64_t apply_time = 0;        // main_time at application
+    uint64_t baseline_hash = 0;     // Hash of the last complete frame before the edge
+    int baseline_leds[5] = {};
+    int64_t change_wall_ns = 0;     // When the changed frame completed / LEDs changed
+    uint64_t change_time = 0;       // main_time of the change
+    uint64_t target_frame = 0;      // Frame to be presented (0 = LED change, next present)
+};
+static LatencyProbe g_probe;
+
+struct LatencySample {
+    int64_t total_ns;               // SDL event -> frame presented
+    int64_t apply_ns;               // SDL event -> applied by simulation thread
+    int64_t change_ns;              // applied -> changed frame complete
+    uint64_t cycles;                // clk cycles from application to change
+    bool led;                       // Change first seen on the LEDs
+};
+static std::vector<LatencySample> g_latency_samples;  // Render thread only
+
+// Hash of the last completed frame (FNV-1a over active pixels), written at VSync
+static uint64_t g_frame_hash = 0xcbf29ce484222325ULL;
+static uint64_t g_last_frame_hash = 0;
+
+// Sampling side: the last frame completed before the edge is the baseline
+static void probe_take_baseline() {
+    g_probe.baseline_hash = g_last_frame_hash;
+    g_probe.state.store(PROBE_WAIT_CHANGE, std::memory_order_release);
+}
+
+static void probe_arm(const InputEvent& ev) {
+    g_probe.input_wall_ns = ev.wall_ns;
+    g_probe.apply_wall_ns = steady_now_ns();
+    g_probe.apply_time = main_time;
+    for (int i = 0; i < 5; i++) {
+        g_probe.baseline_leds[i] = leds_state[i].load(std::memory_order_relaxed);
+    }
+    if (g_pipelined) {
+        g_probe.state.store(PROBE_ARMED, std::memory_order_release);
+    } else {
+        probe_take_baseline();
+    }
+}
+
+static void probe_mark_change(uint64_t target_frame) {
+    g_probe.change_wall_ns = steady_now_ns();
+    g_probe.change_time = sample_time();
+    g_probe.target_frame = target_frame;
+    g_probe.state.store(PROBE_WAIT_PRESENT, std::memory_order_release);
+}
+
+// Simulation thread, every poll interval: the LEDs are visible on the next present
+void probe_check_leds() {
+    if (g_probe.state.load(std::memory_order_relaxed) != PROBE_WAIT_CHANGE) return;
+    for (int i = 0; i < 5; i++) {
+        if (leds_state[i].load(std::memory_order_relaxed) != g_probe.baseline_leds[i]) {
+            probe_mark_change(0);
+            notify_frame_ready();
+            return;
+        }
+    }
+}
+
+// Simulation thread, at VSync after g_last_frame_hash was updated
+void probe_check_frame(uint64_t frame) {
+    if (g_probe.state.load(std::memory_order_relaxed) == PROBE_WAIT_CHANGE &&
+        g_last_frame_hash != g_probe.baseline_hash) {
+        probe_mark_change(frame);
+    }
+}
+
+// Render thread, after presenting frame presented_frame
+void probe_check_present(uint64_t presented_frame, bool led_visible) {
+    if (g_probe.state.load(std::memory_order_acquire) != PROBE_WAIT_PRESENT) return;
+    bool led = g_probe.target_frame == 0;
+    if (led ? !led_visible : presented_frame < g_probe.target_frame) return;
+    
+    LatencySample sample;
+    sample.total_ns = steady_now_ns() - g_probe.input_wall_ns;
+    sample.apply_ns = g_probe.apply_wall_ns - g_probe.input_wall_ns;
+    sample.change_ns = g_probe.change_wall_ns - g_probe.apply_wall_ns;
+    sample.cycles = (g_probe.change_time - g_probe.apply_time) / 2;
+    sample.led = led;
+    g_latency_samples.push_back(sample);
+    g_probe.state.store(PROBE_IDLE, std::memory_order_release);
+}
+
+// Print the latency distribution collected by the probe
+void print_latency_report() {
+    std::vector<LatencySample>& v = g_latency_samples;
+    std::cerr << "\n========== Input Latency Report ==========\n";
+    if (v.empty()) {
+        std::cerr << "No samples (no input caused a visible change)\n";
+        std::cerr << "==========================================\n";
+        return;
+    }
+    std::vector<int64_t> total;
+    int64_t apply_sum = 0, change_sum = 0;
+    uint64_t cycles_sum = 0;
+    size_t led_count = 0;
+    for (size_t i = 0; i < v.size(); i++) {
+        total.push_back(v[i].total_ns);
+        apply_sum += v[i].apply_ns;
+        change_sum += v[i].change_ns;
+        cycles_sum += v[i].cycles;
+        led_count += v[i].led ? 1 : 0;
+    }
+    std::sort(total.begin(), total.end());
+    size_t n = total.size();
+    int64_t total_sum = 0;
+    for (size_t i = 0; i < n; i++) total_sum += total[i];
+    auto pct = [&](double p) { return total[std::min(n - 1, (size_t)(p * n))] / 1000000.0; };
+    
+    std::cerr << "Samples:        " << n << " (" << led_count << " via LEDs, "
+              << n - led_count << " via pixels)\n";
+    std::cerr << "Latency (ms):   min " << total[0] / 1000000.0 << " | p50 " << pct(0.50)
+              << " | p90 " << pct(0.90) << " | p99 " << pct(0.99)
+              << " | max " << total[n - 1] / 1000000.0
+              << " | mean " << total_sum / (double)n / 1000000.0 << "\n";
+    std::cerr << "Breakdown (avg): event->applied " << apply_sum / (double)n / 1000000.0 << "ms"
+              << " | applied->changed " << change_sum / (double)n / 1000000.0 << "ms ("
+              << cycles_sum / n << " clk cycles)"
+              << " | changed->presented " << (total_sum - apply_sum - change_sum) / (double)n / 1000000.0 << "ms\n";
+    
+    // Histogram with power-of-two millisecond buckets
+    const int BUCKETS = 10;
+    size_t hist[BUCKETS] = {};
+    for (size_t i = 0; i < n; i++) {
+        int b = 0;
+        while (b < BUCKETS - 1 && total[i] >= (int64_t)(1000000LL << b)) b++;
+        hist[b]++;
+    }
+    for (int b = 0; b < BUCKETS; b++) {
+        if (!hist[b]) continue;
+        std::cerr << (b == BUCKETS - 1 ? ">= " : "<  ") << (1 << (b == BUCKETS - 1 ? b - 1 : b)) << "ms\t"
+                  << hist[b] << "\t" << std::string(1 + hist[b] * 40 / n, '#') << "\n";
+    }
+    std::cerr << "==========================================\n";
+}
+
+// A board button is pressed while any input source holds it
+enum { SOURCE_MOUSE = 1, SOURCE_KEYBOARD = 2, SOURCE_AUTOCLICK = 4 };
+static uint8_t g_button_sources[5] = {0, 0, 0, 0, 0};  // Render thread only
+
+// Keyboard shortcuts for RESET, B2..B5 (see DevelopmentBoard.v)
+static const SDL_Keycode BUTTON_KEYS[5] = {SDLK_a, SDLK_s, SDLK_d, SDLK_f, SDLK_g};
+
+// Update one source's hold on button i and queue an edge if the combined level changed
+void set_button_source(int i, int source, bool down, Uint32 sdl_timestamp) {
+    bool was_pressed = g_button_sources[i] != 0;
+    if (down) {
+        g_button_sources[i] |= source;
+    } else {
+        g_button_sources[i] &= ~source;
+    }
+    bool pressed = g_button_sources[i] != 0;
+    g_buttons[i].pressed = pressed;
+    if (pressed != was_pressed) {
+        post_input(i, pressed, sdl_timestamp);
+    }
+}
+
+void release_keyboard_buttons(Uint32 sdl_timestamp) {
+    for (int i = 0; i < 5; i++) {
+        if (g_button_sources[i] & SOURCE_KEYBOARD) {
+            set_button_source(i, SOURCE_KEYBOARD, false, sdl_timestamp);
+        }
+    }
+}
+
+// Keyboard path for the board buttons. Runs as an SDL event watch, i.e. while SDL
+// pumps events and before they are queued, so key edges reach the input queue in
+// order without waiting for the event loop. SDL only pumps on the render thread;
+// render_sdl() pumps between its drawing steps, so an edge waits at most for one
+// step (the scaled blit or a panel), not for a whole redraw. SDL stamps events
+// when they are pumped, so that is also the resolution of their timing.
+// Holding several keys at once gives chords; autorepeat is ignored.
+int keyboard_event_watch(void* userdata, SDL_Event* e) {
+    (void)userdata;
+    if ((e->type != SDL_KEYDOWN && e->type != SDL_KEYUP) || e->key.repeat) {
+        return 1;
+    }
+    for (int i = 0; i < 5; i++) {
+        if (e->key.keysym.sym == BUTTON_KEYS[i]) {
+            bool down = e->type == SDL_KEYDOWN;
+            set_button_source(i, SOURCE_KEYBOARD, down, e->key.timestamp);
+            std::cerr << "[Input] Key for '" << g_buttons[i].label << "' "
+                      << (down ? "pressed" : "released") << "\n";
+            break;
+        }
+    }
+    return 1;
+}
+
+// Spacing of button edges (simulation thread). An edge less than
+// MAX_INPUT_GAP_NS of wall time after the edge before it is applied that gap
+// later in 50 MHz board clocks, so a tap within one render frame or while
+// paused keeps its length; later edges apply as soon as they arrive. A
+// simulation slower than real time therefore delays an edge by at most that
+// much board time. Every edge of a key lasts at least one pixel, so the design
+// sees even edges with the same timestamp.
+const int64_t MAX_INPUT_GAP_NS = 100000000;
+struct InputSchedule {
+    int64_t last_wall_ns = 0;       // Wall time and board clock of the last applied edge
+    uint64_t last_clock = 0;
+    uint64_t key_clock[5] = {0, 0, 0, 0, 0};    // Board clock of each key's last edge
+    bool key_seen[5] = {false, false, false, false, false};
+    uint64_t due = 0;               // Board clock the next edge waits for (0 = none)
+};
+static InputSchedule g_input_schedule;
+
+// Apply queued button edges to keys[]; called by the thread that evaluates the
+// model (the eval thread under --pipeline) between batches. An edge that is not
+// due yet stops the queue there, and the next batch ends on the edge's clock
+// (input_batch_size()).
+void apply_input_events() {
+    InputSchedule& sched = g_input_schedule;
+    uint64_t now = main_time / 2;
+    uint64_t pixel = (uint64_t)std::max(1, g_timing.clocks_per_pixel);
+    if (now < sched.last_clock) {
+        sched = InputSchedule();    // Time went back (rewind)
+    }
+    sched.due = 0;
+    InputEvent ev;
+    while (g_input_queue.peek(ev)) {
+        int k = ev.key_index;
+        uint64_t at = now;
+        int64_t gap_ns = std::max<int64_t>(ev.wall_ns - sched.last_wall_ns, 0);
+        if (sched.last_clock > 0 && gap_ns < MAX_INPUT_GAP_NS) {
+            at = std::max(at, sched.last_clock + (uint64_t)gap_ns * BOARD_CLOCKS_PER_MS / 1000000);
+        }
+        if (sched.key_seen[k]) {
+            at = std::max(at, sched.key_clock[k] + pixel);
+        }
+        if (at > now) {
+            sched.due = at;
+            break;
+        }
+        g_input_queue.pop();
+        sched.last_wall_ns = ev.wall_ns;
+        sched.last_clock = now;
+        sched.key_clock[k] = now;
+        sched.key_seen[k] = true;
+        if (g_options.latency_probe &&
+            g_probe.state.load(std::memory_order_relaxed) == PROBE_IDLE) {
+            probe_arm(ev);
+        }
+        keys[ev.key_index].store(ev.pressed ? 0 : 1, std::memory_order_relaxed);
+        if (ev.key_index == 0 && ev.pressed) {
+            restart_triggered.store(true, std::memory_order_relaxed);
+        }
+        
+        uint64_t latency = (uint64_t)(steady_now_ns() - ev.wall_ns);
+        g_input_applied.fetch_add(1, std::memory_order_relaxed);
+        g_input_latency_sum_ns.fetch_add(latency, std::memory_order_relaxed);
+        if (latency > g_input_latency_max_ns.load(std::memory_order_relaxed)) {
+            g_input_latency_max_ns.store(latency, std::memory_order_relaxed);
+        }
+    }
+}
+
 // SDL2 event loop - replaces GLUT callback-based event handling
+// Presentation is driven by the simulated vsync: the simulation thread posts
+// g_frame_ready_event when a frame completes, and this loop sleeps in
+// SDL_WaitEventTimeout until either that or user input arrives.
 void run_event_loop() {
     SDL_Event e;
     bool running = true;
     
-    // Strict event limit per frame
-    const int MAX_EVENTS_PER_FRAME = 1;         // Max 1 event per frame
-    const int TARGET_FPS = 60;
-    const int FRAME_TIME_MS = 1000 / TARGET_FPS; // 16ms
+    const int IDLE_TIMEOUT_MS = 50;             // Wake-up period for LED refresh when no frames arrive
     
     // Debug statistics
-    uint64_t frame_count = 0;
+    uint64_t frame_count = 0;       // Frames presented
+    uint64_t wakeup_count = 0;      // Times the loop woke up (events, frames or timeout)
     uint64_t total_events = 0;
-    uint64_t dropped_events = 0;    // Events not processed due to limit
     uint64_t max_events_in_frame = 0;
+    uint64_t event_cost_sum_ns = 0; // Time spent translating input events
+    uint64_t event_cost_max_ns = 0;
     int64_t max_frame_time = 0;
+    uint64_t all_frames = 0;        // Totals for the final report
+    uint64_t all_events = 0;
     auto last_report = std::chrono::steady_clock::now();
+    int last_leds[5] = {-1, -1, -1, -1, -1};
+    bool redraw = true;             // Draw the initial window contents immediately
+    bool title_turbo = false;       // Turbo and pause state shown in the window title
+    bool title_paused = false;
+    
+    // Auto-clicker state (--autoclick)
+    int64_t autoclick_next_ns = steady_now_ns() + 1000000000LL;  // Let the design settle for 1s
+    bool autoclick_held = false;
+    int autoclick_done = 0;
     
     while (running && !g_quit_requested.load(std::memory_order_acquire)) {
-        auto frame_start = std::chrono::steady_clock::now();
-        frame_count++;
+        bool new_frame = false;
+        flush_input_backlog();
+        int wait_ms = g_input_backlog.empty() ? IDLE_TIMEOUT_MS : 1;
+        
+        // Synthetic clicks for reproducible latency measurement
+        if (g_options.autoclick_button >= 0) {
+            int64_t now_ns = steady_now_ns();
+            if (now_ns >= autoclick_next_ns) {
+                int i = g_options.autoclick_button;
+                if (!autoclick_held && g_options.autoclick_count > 0 &&
+                    autoclick_done >= g_options.autoclick_count) {
+                    std::cerr << "[AutoClick] " << autoclick_done << " clicks done\n";
+                    running = false;
+                    break;
+                }
+                autoclick_held = !autoclick_held;
+                set_button_source(i, SOURCE_AUTOCLICK, autoclick_held, SDL_GetTicks());
+                redraw = true;
+                if (autoclick_held) {
+                    autoclick_next_ns = now_ns + (int64_t)g_options.autoclick_hold_ms * 1000000;
+                } else {
+                    autoclick_done++;
+                    int rest_ms = std::max(1, g_options.autoclick_period_ms - g_options.autoclick_hold_ms);
+                    autoclick_next_ns = now_ns + (int64_t)rest_ms * 1000000;
+                }
+            }
+            int until_ms = (int)((autoclick_next_ns - now_ns) / 1000000) + 1;
+            wait_ms = std::min(wait_ms, std::max(until_ms, 0));
+        }
         
-        // Count actual available events this frame (including those to be dropped)
-        int available_events = 0;
-        while (SDL_PollEvent(&e)) {
+        // Sleep until an input event, a completed frame or the timeout,
+        // then drain everything SDL has queued
+        uint64_t available_events = 0;
+        bool have_event = SDL_WaitEventTimeout(&e, wait_ms) != 0;
+        wakeup_count++;
+        while (have_event) {
+            if (e.type == g_frame_ready_event) {
+                // Frame notifications are not input
+                g_frame_event_pending.store(false, std::memory_order_release);
+                new_frame = true;
+                have_event = SDL_PollEvent(&e) != 0;
+                continue;
+            }
             available_events++;
-            if (available_events <= MAX_EVENTS_PER_FRAME) {
-                // Process this event
-                switch (e.type) {
-                    case SDL_QUIT:
-                        running = false;
-                        break;
-                    case SDL_KEYDOWN:
-                        switch (e.key.keysym.sym) {
-                            case SDLK_ESCAPE:
-                            case SDLK_q:
-                                std::cerr << "[Input] Quit key pressed\n";
-                                running = false;
+            int64_t event_start = steady_now_ns();
+            switch (e.type) {
+                case SDL_QUIT:
+                    running = false;
+                    break;
+                case SDL_WINDOWEVENT:
+                    if (e.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+                        release_keyboard_buttons(e.window.timestamp);
+                    }
+                    redraw = true;
+                    break;
+                case SDL_KEYDOWN:
+                    switch (e.key.keysym.sym) {
+                        case SDLK_ESCAPE:
+                        case SDLK_q:
+                            std::cerr << "[Input] Quit key pressed\n";
+                            running = false;
+                            break;
+                        case SDLK_p:
+                            post_debug_command(DEBUG_PAUSE, 0);
+                            break;
+                        case SDLK_n:
+                            post_debug_command(DEBUG_STEP_FRAME, 0);
+                            break;
+                        case SDLK_l:
+                            post_debug_command(DEBUG_STEP_LINE, 0);
+                            break;
+                        case SDLK_c:
+                            post_debug_command(DEBUG_STEP_CYCLES, g_options.step_cycles);
+                            break;
+                        case SDLK_e:
+                            post_debug_command(DEBUG_UNTIL_LED, 0);
+                            break;
+                        case SDLK_x:
+                            post_debug_command(DEBUG_UNTIL_PIXEL, watch_pixel_arg());
+                            break;
+                        case SDLK_LEFT:
+                            post_debug_command(DEBUG_REWIND, 1);
+                            break;
+                        case SDLK_PAGEUP:
+                            post_debug_command(DEBUG_REWIND, 60);
+                            break;
+                        case SDLK_t:
+                            if (g_turbo_allowed) {
+                                g_turbo.store(!g_turbo.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                            } else {
+                                std::cerr << "[Turbo] Not available with --hash-every, --latency-probe or --pixel-check\n";
+                            }
+                            break;
+                        case SDLK_EQUALS:
+                        case SDLK_PLUS:
+                        case SDLK_MINUS:
+                            if (g_analyzer.enabled) {
+                                analyzer_zoom(e.key.keysym.sym != SDLK_MINUS);
+                            }
+                            break;
+                        case SDLK_COMMA:
+                        case SDLK_PERIOD:
+                            if (g_analyzer.enabled) {
+                                analyzer_pan(e.key.keysym.sym == SDLK_COMMA);
+                            }
+                            break;
+                        case SDLK_BACKSPACE:
+                            g_analyzer_view.pan = 0;
+                            g_analyzer_view.cursor_set[0] = g_analyzer_view.cursor_set[1] = false;
+                            break;
+                    }
+                    redraw = true;  // Button keys were applied by keyboard_event_watch()
+                    break;
+                case SDL_KEYUP:
+                    redraw = true;
+                    break;
+                case SDL_MOUSEBUTTONDOWN:
+                    if (analyzer_click(e.button.x, e.button.y, e.button.button)) {
+                        redraw = true;
+                    } else if (e.button.button == SDL_BUTTON_LEFT) {
+                        int mx = e.button.x;
+                        int my = e.button.y;
+                        for (int i = 0; i < 5; i++) {
+                            SDL_Rect* r = &g_buttons[i].rect;
+                            if (mx >= r->x && mx < r->x + r->w &&
+                                my >= r->y && my < r->y + r->h) {
+                                g_active_button = i;
+                                set_button_source(i, SOURCE_MOUSE, true, e.button.timestamp);
+                                std::cerr << "[Input] Button '" << g_buttons[i].label << "' pressed\n";
+                                redraw = true;
                                 break;
-                        }
-                        break;
-                    case SDL_MOUSEBUTTONDOWN:
-                        if (e.button.button == SDL_BUTTON_LEFT) {
-                            int mx = e.button.x;
-                            int my = e.button.y;
-                            for (int i = 0; i < 5; i++) {
-                                SDL_Rect* r = &g_buttons[i].rect;
-                                if (mx >= r->x && mx < r->x + r->w &&
-                                    my >= r->y && my < r->y + r->h) {
-                                    g_buttons[i].pressed = true;
-                                    g_active_button = i;
-                                    keys[i].store(0, std::memory_order_release);
-                                    if (i == 0) {
-                                        restart_triggered.store(true, std::memory_order_release);
-                                    }
-                                    std::cerr << "[Input] Button '" << g_buttons[i].label << "' pressed\n";
-                                    break;
-                                }
                             }
                         }
-                        break;
-                    case SDL_MOUSEBUTTONUP:
-                        if (e.button.button == SDL_BUTTON_LEFT && g_active_button >= 0) {
+                    }
+                    break;
+                case SDL_MOUSEWHEEL:
+                    if (g_analyzer.enabled && e.wheel.y != 0) {
+                        analyzer_zoom(e.wheel.y > 0);
+                        redraw = true;
+                    }
+                    break;
+                case SDL_MOUSEBUTTONUP:
+                    if (e.button.button == SDL_BUTTON_LEFT && g_active_button >= 0) {
+                        int i = g_active_button;
+                        set_button_source(i, SOURCE_MOUSE, false, e.button.timestamp);
+                        std::cerr << "[Input] Button '" << g_buttons[i].label << "' released\n";
+                        g_active_button = -1;
+                        redraw = true;
+                    }
+                    break;
+                case SDL_MOUSEMOTION:
+                    // If mouse drags out of the active button, auto-release
+                    if (g_active_button >= 0) {
+                        int mx = e.motion.x;
+                        int my = e.motion.y;
+                        SDL_Rect* r = &g_buttons[g_active_button].rect;
+                        if (mx < r->x || mx >= r->x + r->w ||
+                            my < r->y || my >= r->y + r->h) {
                             int i = g_active_button;
-                            g_buttons[i].pressed = false;
-                            keys[i].store(1, std::memory_order_release);
-                            std::cerr << "[Input] Button '" << g_buttons[i].label << "' released\n";
+                            set_button_source(i, SOURCE_MOUSE, false, e.motion.timestamp);
+                            std::cerr << "[Input] Button '" << g_buttons[i].label << "' released (drag out)\n";
                             g_active_button = -1;
+                            redraw = true;
                         }
-                        break;
-                    case SDL_MOUSEMOTION:
-                        // If mouse drags out of the active button, auto-release
-                        if (g_active_button >= 0) {
-                            int mx = e.motion.x;
-                            int my = e.motion.y;
-                            SDL_Rect* r = &g_buttons[g_active_button].rect;
-                            if (mx < r->x || mx >= r->x + r->w ||
-                                my < r->y || my >= r->y + r->h) {
-                                int i = g_active_button;
-                                g_buttons[i].pressed = false;
-                                keys[i].store(1, std::memory_order_release);
-                                std::cerr << "[Input] Button '" << g_buttons[i].label << "' released (drag out)\n";
-                                g_active_button = -1;
-                            }
-                        }
-                        break;
-                }
-            } else {
-                // Count dropped events
-                dropped_events++;
+                    }
+                    break;
             }
+            uint64_t event_cost = (uint64_t)(steady_now_ns() - event_start);
+            event_cost_sum_ns += event_cost;
+            if (event_cost > event_cost_max_ns) {
+                event_cost_max_ns = event_cost;
+            }
+            have_event = SDL_PollEvent(&e) != 0;
         }
         
-        total_events += (available_events <= MAX_EVENTS_PER_FRAME) ? available_events : MAX_EVENTS_PER_FRAME;
-        if ((uint64_t)available_events > max_events_in_frame) {
+        total_events += available_events;
+        if (available_events > max_events_in_frame) {
             max_events_in_frame = available_events;
         }
         
-        // Warning if events were dropped
-        if (available_events > MAX_EVENTS_PER_FRAME) {
-            std::cerr << "[EventLoop] Dropped " << (available_events - MAX_EVENTS_PER_FRAME) 
-                      << " events this frame (processed " << MAX_EVENTS_PER_FRAME 
-                      << "/" << available_events << ")\n";
+        // The simulation thread ends --turbo-until and steps on its own
+        bool turbo = g_turbo.load(std::memory_order_relaxed);
+        bool paused = g_debug_paused.load(std::memory_order_relaxed);
+        if (turbo != title_turbo || paused != title_paused) {
+            title_turbo = turbo;
+            title_paused = paused;
+            std::string title = WINDOW_TITLE + (turbo ? " [TURBO]" : "") + (paused ? " [PAUSED]" : "");
+            SDL_SetWindowTitle(g_window, title.c_str());
         }
         
-        // Render frame
-        render_sdl();
-        
-        // Adaptive frame rate control
-        auto frame_end = std::chrono::steady_clock::now();
-        auto frame_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-            frame_end - frame_start).count();
-        
-        if (frame_duration > max_frame_time) {
-            max_frame_time = frame_duration;
+        // LEDs are not tied to frames, so refresh whenever they change
+        for (int i = 0; i < 5; i++) {
+            int led = leds_state[i].load(std::memory_order_relaxed);
+            if (led != last_leds[i]) {
+                last_leds[i] = led;
+                redraw = true;
+            }
         }
         
-        int delay_ms = FRAME_TIME_MS - (int)frame_duration;
-        if (delay_ms > 0) {
-            SDL_Delay(delay_ms);
-        } else if (delay_ms < -5) {
-            // Frame time exceeded target by more than 5ms, output warning
-            std::cerr << "[EventLoop] Slow frame: " << frame_duration 
-                      << "ms (target: " << FRAME_TIME_MS << "ms)\n";
+        // Present only when something visible changed
+        if (new_frame || redraw) {
+            auto render_start = std::chrono::steady_clock::now();
+            bool probe_led_visible = g_probe.state.load(std::memory_order_acquire) == PROBE_WAIT_PRESENT;
+            render_sdl();
+            probe_check_present(g_presented_frame, probe_led_visible);
+            frame_count++;
+            redraw = false;
+            
+            auto render_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - render_start).count();
+            if (render_duration > max_frame_time) {
+                max_frame_time = render_duration;
+            }
+            if (render_duration > 16) {
+                std::cerr << "[EventLoop] Slow render: " << render_duration << "ms\n";
+            }
         }
         
         // Print statistics report every second
         auto now = std::chrono::steady_clock::now();
         auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - last_report).count();
         if (elapsed >= 1) {
+            uint64_t applied = g_input_applied.exchange(0, std::memory_order_relaxed);
+            uint64_t latency_sum = g_input_latency_sum_ns.exchange(0, std::memory_order_relaxed);
+            uint64_t latency_max = g_input_latency_max_ns.exchange(0, std::memory_order_relaxed);
             std::cerr << "[EventLoop] FPS: " << frame_count 
+                      << " | Wakeups: " << wakeup_count
                       << " | Events: " << total_events 
-                      << " | Dropped: " << dropped_events
-                      << " | MaxEvents/Frame: " << max_events_in_frame
+                      << " | MaxEvents/Wakeup: " << max_events_in_frame
                       << " | MaxFrameTime: " << max_frame_time << "ms\n";
+            if (total_events > 0 || applied > 0) {
+                std::cerr << "[Input] EventCost avg/max: " << event_cost_sum_ns / (total_events ? total_events : 1)
+                          << "/" << event_cost_max_ns << "ns"
+                          << " | Applied: " << applied
+                          << " | Latency avg/max: " << latency_sum / (applied ? applied : 1) / 1000
+                          << "/" << latency_max / 1000 << "us"
+                          << " | Backlog: " << g_input_backlog.size() << "\n";
+            }
+            all_frames += frame_count;
+            all_events += total_events;
             frame_count = 0;
+            wakeup_count = 0;
             total_events = 0;
-            dropped_events = 0;
             max_events_in_frame = 0;
+            event_cost_sum_ns = 0;
+            event_cost_max_ns = 0;
             max_frame_time = 0;
             last_report = now;
         }
@@ -517,20 +1631,172 @@ void run_event_loop() {
     
     // Output final statistics
     std::cerr << "\n========== EventLoop Final Stats ==========\n";
-    std::cerr << "Total frames processed: " << frame_count << "\n";
-    std::cerr << "Total events processed: " << total_events << "\n";
-    std::cerr << "Total events dropped:   " << dropped_events << "\n";
-    std::cerr << "Max events in one frame: " << max_events_in_frame << "\n";
+    std::cerr << "Total frames presented: " << all_frames + frame_count << "\n";
+    std::cerr << "Total events processed: " << all_events + total_events << "\n";
+    std::cerr << "Events still queued:    " << g_input_backlog.size() << "\n";
     std::cerr << "===========================================\n";
     
+    if (g_options.latency_probe) {
+        print_latency_report();
+    }
+    
     g_quit_requested.store(true, std::memory_order_release);
 }
 
 // tracking VGA signals
 int coord_x = 0;
 int coord_y = 0;
-bool pre_h_sync = 0;
-bool pre_v_sync = 0;
+bool pre_h_sync = 0;    // Previous sample was inside the h_sync pulse
+bool pre_v_sync = 0;    // Previous sample was inside the v_sync pulse
+
+// Loaded design plugin (see design_plugin.h). The host never includes the
+// Verilated model; every evaluation goes through the plugin's function table.
+struct DesignPlugin {
+    void* library = nullptr;
+    const VgaDesignApi* api = nullptr;
+    void* instance = nullptr;
+    std::string copy_path;          // Private copy that was loaded
+};
+static DesignPlugin g_design;
+static DesignPlugin g_reference;            // --diff: reference design, own ports and time
+static VgaDesignPorts g_reference_ports;
+static uint64_t g_reference_time = 0;
+static int g_design_generation = 0;
+static std::vector<char*> g_design_args;    // argv for the plugin's plusargs
+
+#if defined(_WIN32)
+static void* open_library(const char* path) { return (void*)LoadLibraryA(path); }
+static void* find_symbol(void* lib, const char* name) { return (void*)GetProcAddress((HMODULE)lib, name); }
+static void close_library(void* lib) { FreeLibrary((HMODULE)lib); }
+static std::string library_error() { return "error " + std::to_string(GetLastError()); }
+static int process_id() { return (int)GetCurrentProcessId(); }
+#else
+static void* open_library(const char* path) { return dlopen(path, RTLD_NOW | RTLD_LOCAL); }
+static void* find_symbol(void* lib, const char* name) { return dlsym(lib, name); }
+static void close_library(void* lib) { dlclose(lib); }
+static std::string library_error() { const char* e = dlerror(); return e ? e : "unknown error"; }
+static int process_id() { return (int)getpid(); }
+#endif
+
+void unload_design(DesignPlugin& d) {
+    if (d.instance) d.api->destroy(d.instance);
+    if (d.library) close_library(d.library);
+    if (!d.copy_path.empty()) std::remove(d.copy_path.c_str());  // Windows keeps it until now
+    d = DesignPlugin();
+}
+
+// Load and instantiate the plugin at path. The file is copied first so the
+// build can replace it, and so dlopen() does not hand back the cached old image.
+bool load_design(const std::string& path, DesignPlugin& d, std::string& error) {
+    d.copy_path = path + ".live-" + std::to_string(process_id()) + "-" + std::to_string(g_design_generation);
+    {
+        std::ifstream src(path.c_str(), std::ios::binary);
+        if (!src) {
+            error = "cannot open " + path;
+            d.copy_path.clear();
+            return false;
+        }
+        std::ofstream dst(d.copy_path.c_str(), std::ios::binary | std::ios::trunc);
+        if (!dst || !(dst << src.rdbuf())) {
+            error = "cannot copy " + path + " to " + d.copy_path;
+            std::remove(d.copy_path.c_str());
+            d.copy_path.clear();
+            return false;
+        }
+    }
+    d.library = open_library(d.copy_path.c_str());
+#if !defined(_WIN32)
+    std::remove(d.copy_path.c_str());  // The mapping stays valid
+    d.copy_path.clear();
+#endif
+    if (!d.library) {
+        error = library_error();
+        unload_design(d);
+        return false;
+    }
+    VgaDesignEntryFn entry = (VgaDesignEntryFn)find_symbol(d.library, VGA_DESIGN_ENTRY);
+    d.api = entry ? entry() : nullptr;
+    if (!d.api) {
+        error = std::string("no ") + VGA_DESIGN_ENTRY + "() in " + path;
+        unload_design(d);
+        return false;
+    }
+    if (d.api->abi_version != VGA_DESIGN_ABI_VERSION || d.api->ports_size != sizeof(VgaDesignPorts)) {
+        error = "plugin ABI " + std::to_string(d.api->abi_version) + " does not match the host's " +
+                std::to_string(VGA_DESIGN_ABI_VERSION) + ", rebuild it";
+        d.api = nullptr;
+        unload_design(d);
+        return false;
+    }
+    d.instance = d.api->create((int)g_design_args.size() - 1, g_design_args.data());
+    if (!d.instance) {
+        error = "the plugin failed to create the model";
+        unload_design(d);
+        return false;
+    }
+    g_design_generation++;
+    return true;
+}
+
+// --watch-design: poll the plugin file about twice a second (simulation thread)
+struct DesignFileState {
+    bool exists = false;
+    long long mtime = 0;
+    long long size = 0;
+    bool operator==(const DesignFileState& o) const {
+        return exists == o.exists && mtime == o.mtime && size == o.size;
+    }
+};
+static DesignFileState g_design_file_loaded;    // State of the file the current plugin came from
+static DesignFileState g_design_file_last;      // Last polled state, to wait for writes to settle
+static int64_t g_design_next_poll_ns = 0;
+
+DesignFileState stat_design_file() {
+    DesignFileState st;
+    struct stat info;
+    if (stat(g_options.design_path.c_str(), &info) == 0) {
+        st.exists = true;
+        st.mtime = (long long)info.st_mtime;
+        st.size = (long long)info.st_size;
+    }
+    return st;
+}
+
+// True once the plugin file changed and was stable for one poll interval
+bool design_reload_due() {
+    if (!g_options.watch_design) return false;
+    int64_t now = steady_now_ns();
+    if (now < g_design_next_poll_ns) return false;
+    g_design_next_poll_ns = now + 500000000LL;
+    DesignFileState st = stat_design_file();
+    bool settled = st == g_design_file_last;
+    g_design_file_last = st;
+    return settled && st.exists && !(st == g_design_file_loaded);
+}
+
+// Swap in the rebuilt plugin; on failure the old design keeps running
+bool reload_design() {
+    g_design_file_loaded = g_design_file_last;   // Do not retry until the file changes again
+    DesignPlugin fresh;
+    std::string error;
+    if (!load_design(g_options.design_path, fresh, error)) {
+        std::cerr << "[Design] Reload of " << g_options.design_path << " failed: " << error
+                  << "; keeping the previous design\n";
+        return false;
+    }
+    unload_design(g_design);
+    g_design = fresh;
+    std::cerr << "[Design] Reloaded " << g_options.design_path << " (generation " << g_design_generation << ")\n";
+    return true;
+}
+
+inline bool design_finished() {
+    return g_design.api->got_finish(g_design.instance) != 0;
+}
+
+inline void design_eval() {
+    g_design.api->eval(g_design.instance, display, main_time);
+}
 
 // set Verilog module inputs based on arrow key inputs
 void apply_input() {
@@ -551,7 +1817,7 @@ void update_leds(){
 
 void display_eval(){
     apply_input();
-    display->eval();
+    design_eval();
     update_leds();
 }
 // simulate for a single clock
@@ -568,110 +1834,2376 @@ void tick() {
     display_eval();
 }
 
-// globally reset the model
-void reset() {
-    display->reset = 0; // Reset signal initially high (not resetting)
-    display->B2 = 1;
-    display->B3 = 1;
-    display->B4 = 1;
-    display->B5 = 1;
-    display->clk = 0;
-    display->eval();
+// Min/max of one timing quantity over a report interval
+struct RangeStat {
+    int min = INT_MAX;
+    int max = INT_MIN;
+    uint64_t count = 0;
+    
+    void add(int v) {
+        if (v < min) min = v;
+        if (v > max) max = v;
+        count++;
+    }
+    void clear() { *this = RangeStat(); }
+};
+
+// Sync timing monitor, fed by the samplers. Measures every line's h_sync period
+// and pulse width (pixels), every frame's v_sync period and pulse width (lines)
+// and non-black rgb during blanking, and reports them against the configured
+// mode every g_options.timing_report frames.
+struct SyncMonitor {
+    uint64_t samples = 0;           // Samples processed so far (the current sample's index)
+    uint64_t h_edge_at = 0;         // Index of the last h_sync leading edge
+    uint64_t restart_at = 0;        // A pulse already active here is not an edge
+    uint64_t h_seen_at = 0;         // Last h_sync / v_sync edge of either direction (watchdog)
+    uint64_t v_seen_at = 0;
+    bool have_h_edge = false;
+    bool have_v_edge = false;
+    int lines_since_v = 0;          // h_sync edges since the last v_sync edge
+    int v_pulse_lines = 0;          // h_sync edges inside the current v_sync pulse
+    
+    RangeStat h_period, h_pulse, v_period, v_pulse;
+    uint64_t blank_pixels = 0;      // Non-zero rgb outside the active window
+    int blank_x = -1, blank_y = -1; // First such pixel in this interval
+    uint64_t first_frame = 0;
+    uint64_t violations = 0;        // Reports with at least one violation
+    
+    // Active window relative to the sync edges (set_timing)
+    int x0 = 0, x1 = 0, y0 = 0, y1 = 0;
+    
+    void h_lead(uint64_t at, bool in_v_pulse) {
+        if (have_h_edge) h_period.add((int)std::min<uint64_t>(at - h_edge_at, INT_MAX));
+        h_edge_at = at;
+        h_seen_at = at;
+        have_h_edge = at != restart_at;
+        lines_since_v++;
+        if (in_v_pulse) v_pulse_lines++;
+    }
+    void h_trail(uint64_t at) {
+        h_seen_at = at;
+        if (have_h_edge) h_pulse.add((int)std::min<uint64_t>(at - h_edge_at, INT_MAX));
+    }
+    void v_lead(uint64_t at) {
+        v_seen_at = at;
+        if (have_v_edge) v_period.add(lines_since_v);
+        have_v_edge = at != restart_at;
+        lines_since_v = 0;
+        v_pulse_lines = 0;
+    }
+    void v_trail(uint64_t at) {
+        v_seen_at = at;
+        if (have_v_edge) v_pulse.add(v_pulse_lines);
+    }
+    void blank_pixel(int x, int y, uint64_t n) {
+        if (blank_pixels == 0) {
+            blank_x = x;
+            blank_y = y;
+        }
+        blank_pixels += n;
+    }
+    // Forget the edge references (design reset or new timing), keep the statistics
+    void restart() {
+        restart_at = samples;
+        h_seen_at = samples;
+        v_seen_at = samples;
+        have_h_edge = false;
+        have_v_edge = false;
+        lines_since_v = 0;
+        v_pulse_lines = 0;
+    }
+    void clear_interval(uint64_t next_frame) {
+        h_period.clear();
+        h_pulse.clear();
+        v_period.clear();
+        v_pulse.clear();
+        blank_pixels = 0;
+        blank_x = blank_y = -1;
+        first_frame = next_frame;
+    }
+};
+static SyncMonitor g_sync_monitor;
+
+// Reset pulse for the --diff reference, clock for clock the same as the
+// design's in reset_model() (10 clocks with the buttons as the user holds them)
+void reset_reference() {
+    VgaDesignPorts* ports = &g_reference_ports;
+    ports->reset = 0;
+    ports->B2 = 1;
+    ports->B3 = 1;
+    ports->B4 = 1;
+    ports->B5 = 1;
+    ports->clk = 0;
+    g_reference_time = main_time;
+    g_reference.api->eval(g_reference.instance, ports, g_reference_time);
+    for (int i = 0; i < 20; i++) {
+        ports->clk = (i & 1) ? 0 : 1;
+        ports->reset = keys[0];
+        ports->B2 = keys[1];
+        ports->B3 = keys[2];
+        ports->B4 = keys[3];
+        ports->B5 = keys[4];
+        g_reference.api->eval(g_reference.instance, ports, ++g_reference_time);
+    }
+    ports->reset = 1;
+}
+
+// reset the model and the inputs driven into it
+void reset_model() {
+    if (g_reference.instance) {
+        reset_reference();
+    }
+    display->reset = 0; // Reset signal initially high (not resetting)
+    display->B2 = 1;
+    display->B3 = 1;
+    display->B4 = 1;
+    display->B5 = 1;
+    display->clk = 0;
+    design_eval();
     for(int i = 0; i < 10; i++) {
         tick();
     }
-    display->reset = 1;
+    display->reset = 1;
+    
+    // Reset key states
+    for (int i = 0; i < 5; i++) {
+        keys[i].store(1);
+    }
+    
+    // Reset LED states
+    for (int i = 0; i < 5; i++) {
+        leds_state[i].store(1);
+    }
+}
+
+// Reset the sampling side (the sampler thread with --pipeline)
+void reset_sampler() {
+    // Clear graphics buffers
+    std::memset(buffer_a, 0, sizeof(buffer_a));
+    std::memset(buffer_b, 0, sizeof(buffer_b));
+     
+    // Reset VGA signal tracking variables
+    coord_x = 0;
+    coord_y = 0;
+    pre_h_sync = 0;
+    pre_v_sync = 0;
+    g_sync_monitor.restart();
+    g_pixel_checks_armed = false;
+}
+
+// globally reset the model and the sampler
+void reset() {
+    reset_model();
+    reset_sampler();
+}
+
+// Packed VGA output sample: rgb in bits 0-15 and the sync pulses in bits 16/17.
+// Sync bits are normalised to 1 = inside the pulse whatever the design's polarity.
+const uint32_t SAMPLE_H_SYNC = 1u << 16;
+const uint32_t SAMPLE_V_SYNC = 1u << 17;
+static uint32_t g_sync_invert = 0;      // XOR mask for active-low sync pulses
+
+// Rewind checkpoints (simulation thread): model snapshots every
+// --checkpoint-every frames, oldest dropped beyond --checkpoint-mb, plus a log
+// of every input change since the oldest one so the gap can be re-simulated
+struct Checkpoint {
+    uint64_t frame;                 // g_vsync_count when taken
+    uint64_t first_full_frame;      // First frame drawn completely after it
+    uint64_t time;                  // main_time
+    std::vector<uint8_t> model;     // VgaDesignApi::save_state
+    VgaDesignPorts ports;
+    int coord_x, coord_y;
+    bool pre_h_sync, pre_v_sync;
+    SyncMonitor monitor;
+    uint64_t frame_hash, last_frame_hash, last_change_frame;
+};
+struct InputRecord {
+    uint64_t time;                  // main_time the inputs took effect
+    int inputs;                     // reset | B2 << 1 | .. | B5 << 4, or INPUT_RESET
+};
+const int INPUT_RESET = -1;         // reset() was called
+struct RewindState {
+    bool enabled = false;
+    bool replaying = false;         // Inputs come from the log, not the user
+    std::deque<Checkpoint> ring;
+    std::deque<InputRecord> inputs;
+    int last_inputs = -1;
+    size_t bytes = 0;
+    uint64_t next_frame = 0;        // Take the next checkpoint once g_vsync_count reaches this
+    uint64_t saves = 0;             // Cost of taking checkpoints
+    int64_t save_ns_sum = 0, save_ns_max = 0;
+};
+static RewindState g_rewind;
+
+int input_bits() {
+    return (display->reset & 1) | (display->B2 & 1) << 1 | (display->B3 & 1) << 2 |
+           (display->B4 & 1) << 3 | (display->B5 & 1) << 4;
+}
+
+void set_keys(int inputs) {
+    for (int i = 0; i < 5; i++) {
+        keys[i].store((inputs >> i) & 1, std::memory_order_relaxed);
+    }
+}
+
+void log_input(int inputs) {
+    if (inputs != g_rewind.last_inputs || inputs == INPUT_RESET) {
+        g_rewind.last_inputs = inputs;
+        InputRecord r = {main_time, inputs};
+        g_rewind.inputs.push_back(r);
+    }
+}
+
+// Run count pixels of the current mode in the plugin, packing one sample per pixel
+void run_pixels(uint32_t* samples, int count) {
+    apply_input();
+    if (g_rewind.enabled && !g_rewind.replaying) {
+        log_input(input_bits());
+    }
+    main_time = g_design.api->run_pixels(g_design.instance, display, main_time,
+                                         g_timing.clocks_per_pixel, g_sync_invert, samples, count);
+    update_leds();
+}
+
+const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+void format_range(std::ostringstream& os, const RangeStat& r) {
+    if (r.count == 0) {
+        os << "-";
+    } else if (r.min == r.max) {
+        os << r.min;
+    } else {
+        os << r.min << ".." << r.max;
+    }
+}
+
+// Print one line of measured timing (plus one line per violation) and start a new interval.
+// VESA's +/-0.5% tolerance is on the pixel clock, which the simulator fixes per
+// mode, so periods and pulse widths in pixels and lines must match exactly.
+void print_sync_report(uint64_t frame) {
+    SyncMonitor& m = g_sync_monitor;
+    const VgaTiming& t = g_timing;
+    
+    std::vector<std::string> problems;
+    auto check = [&](const RangeStat& r, int expected, const char* what, const char* unit) {
+        if (r.count == 0 || (r.min == expected && r.max == expected)) return;
+        std::ostringstream os;
+        os << what << " ";
+        format_range(os, r);
+        os << " " << unit << ", expected " << expected;
+        if (r.max > r.min) os << " (jitter " << (r.max - r.min) << ")";
+        problems.push_back(os.str());
+    };
+    check(m.h_period, t.h_total(), "H period", "px");
+    check(m.h_pulse, t.h_sync, "H sync pulse", "px");
+    check(m.v_period, t.v_total(), "V period", "lines");
+    check(m.v_pulse, t.v_sync, "V sync pulse", "lines");
+    if (m.blank_pixels > 0) {
+        std::ostringstream os;
+        os << "rgb non-zero during blanking on " << m.blank_pixels << " px, first at x=" << m.blank_x
+           << " y=" << m.blank_y << " from the sync edges (active window x " << m.x0 << ".." << (m.x1 - 1)
+           << ", y " << m.y0 << ".." << (m.y1 - 1) << ")";
+        problems.push_back(os.str());
+    }
+    
+    std::ostringstream os;
+    os << "[Timing] Frames " << m.first_frame << "-" << frame << ": H ";
+    format_range(os, m.h_period);
+    os << " px, sync ";
+    format_range(os, m.h_pulse);
+    os << " | V ";
+    format_range(os, m.v_period);
+    os << " lines, sync ";
+    format_range(os, m.v_pulse);
+    os << " | blanking rgb " << m.blank_pixels << " px | ";
+    if (problems.empty()) {
+        os << "OK (" << t.name << ")\n";
+    } else {
+        m.violations++;
+        os << problems.size() << " violation" << (problems.size() > 1 ? "s" : "") << " of " << t.name << "\n";
+        for (const std::string& p : problems) {
+            os << "[Timing]   " << p << "\n";
+        }
+        if (g_options.strict_timing) {
+            g_check_failed = true;
+        }
+    }
+    std::cerr << os.str();
+    m.clear_interval(frame + 1);
+}
+
+// --pixel-check=FILE: invariants on every finished frame, one per line:
+// "COLOR X0 Y0 X1 Y1 MIN MAX" requires MIN..MAX pixels of RGB565 colour COLOR
+// (hex, or * for any non-black colour) in the active-area rectangle
+// [X0,X1) x [Y0,Y1). MAX may be * for no limit; '#' starts a comment.
+// E.g. "F800 0 0 640 480 1 *" = a red pixel is on screen in every frame.
+struct PixelCheck {
+    int line;
+    std::string text;
+    int color;                      // -1 = any non-black colour
+    int x0, y0, x1, y1;
+    uint64_t min, max;
+    uint64_t failures = 0;
+};
+static std::vector<PixelCheck> g_pixel_checks;
+
+bool load_pixel_checks(const std::string& path, std::string& error) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string color, max;
+        PixelCheck check;
+        if (!(fields >> color)) continue;   // Blank or comment line
+        char* end = nullptr;
+        check.color = color == "*" ? -1 : (int)strtol(color.c_str(), &end, 16);
+        bool ok = (color == "*" || (*end == '\0' && check.color >= 0 && check.color <= 0xFFFF)) &&
+                  (fields >> check.x0 >> check.y0 >> check.x1 >> check.y1 >> check.min >> max);
+        if (ok) {
+            check.max = max == "*" ? UINT64_MAX : strtoull(max.c_str(), &end, 10);
+            ok = max == "*" || *end == '\0';
+        }
+        if (!ok || check.x1 <= check.x0 || check.y1 <= check.y0 || check.max < check.min) {
+            std::ostringstream os;
+            os << path << ":" << line_no << ": expected \"COLOR X0 Y0 X1 Y1 MIN MAX\"";
+            error = os.str();
+            return false;
+        }
+        check.line = line_no;
+        std::ostringstream text;
+        text << color << " " << check.x0 << " " << check.y0 << " " << check.x1 << " " << check.y1
+             << " " << check.min << " " << max;
+        check.text = text.str();
+        g_pixel_checks.push_back(check);
+    }
+    return true;
+}
+
+// Count the pixels of every check in the frame that just finished
+void check_pixels(uint64_t frame) {
+    if (!g_pixel_checks_armed) {
+        g_pixel_checks_armed = true;        // This frame started before the reset
+        return;
+    }
+    const uint16_t* buf = write_buffer.load(std::memory_order_relaxed);
+    for (PixelCheck& c : g_pixel_checks) {
+        int x1 = std::min(c.x1, ACTIVE_WIDTH);
+        int y1 = std::min(c.y1, ACTIVE_HEIGHT);
+        uint64_t count = 0;
+        for (int y = std::max(c.y0, 0); y < y1; y++) {
+            const uint16_t* row = buf + (size_t)y * ACTIVE_WIDTH;
+            for (int x = std::max(c.x0, 0); x < x1; x++) {
+                count += c.color < 0 ? row[x] != 0 : row[x] == c.color;
+            }
+        }
+        if (count >= c.min && count <= c.max) continue;
+        if (c.failures++ == 0) {
+            std::cerr << "[Check] Frame " << frame << ": " << count << " matching pixels, pixel check line "
+                      << c.line << " (" << c.text << ") failed\n";
+        }
+        g_check_failed = true;
+    }
+}
+
+// Fast-forward state (sampler thread)
+static bool g_frame_skipped = false;    // The current frame is neither stored, hashed nor published
+static uint64_t g_replay_target = 0;    // Rewinding: frames before this one are skipped (0 = off)
+static bool g_turbo_running = false;    // g_turbo as of the last frame boundary
+static uint64_t g_turbo_start_frame = 0;
+static int64_t g_turbo_start_ns = 0;
+
+// Decide at a frame boundary whether the frame that starts now is drawn
+void update_turbo() {
+    bool turbo = g_turbo.load(std::memory_order_relaxed);
+    if (turbo && g_options.turbo_until > 0 && g_vsync_count + 1 >= g_options.turbo_until) {
+        turbo = false;      // The target frame is drawn
+        g_turbo.store(false, std::memory_order_relaxed);
+    }
+    if (turbo != g_turbo_running) {
+        g_turbo_running = turbo;
+        int64_t now_ns = steady_now_ns();
+        if (turbo) {
+            g_turbo_start_frame = g_vsync_count;
+            g_turbo_start_ns = now_ns;
+            std::cerr << "[Turbo] On at frame " << g_vsync_count << "\n";
+        } else {
+            g_options.turbo_until = 0;
+            uint64_t frames = g_vsync_count - g_turbo_start_frame;
+            double seconds = (now_ns - g_turbo_start_ns) / 1e9;
+            char rate[32];
+            snprintf(rate, sizeof(rate), "%.1f", seconds > 0 ? frames / seconds : 0.0);
+            std::cerr << "[Turbo] Off at frame " << g_vsync_count << ": " << frames << " frames at "
+                      << rate << " frames/s\n";
+        }
+    }
+    uint64_t next = g_vsync_count + 1;
+    g_frame_skipped = turbo && (g_options.turbo_until > 0 || g_options.turbo_every == 0 ||
+                                next % g_options.turbo_every != 0);
+}
+
+// Frame boundary (v_sync leading edge): publish the finished frame
+void finish_frame() {
+    g_vsync_count++;
+    bool skipped = g_frame_skipped;
+    if (!skipped) {
+        if (g_frame_hash != g_last_frame_hash) {
+            g_last_change_frame = g_vsync_count;
+        }
+        g_last_frame_hash = g_frame_hash;
+        probe_check_frame(g_vsync_count);
+        if (!g_pixel_checks.empty()) {
+            check_pixels(g_vsync_count);
+        }
+    }
+    g_frame_hash = FNV_OFFSET;
+    
+    if (g_replay_target > 0) {
+        // Rewinding (rewind_frames()): re-simulate quietly, drawing only the target frame
+        g_frame_skipped = g_vsync_count + 1 < g_replay_target;
+    } else {
+        // Output every 60 frames (~1 second)
+        if (g_vsync_count % 60 == 0) {
+            std::cerr << "[VGA] VSync #" << g_vsync_count 
+                      << " (frame " << (g_vsync_count / 60) << "s)\n";
+        }
+        if (g_options.timing_report > 0 && g_vsync_count % g_options.timing_report == 0) {
+            print_sync_report(g_vsync_count);
+        }
+        if (g_options.hash_every > 0 && g_vsync_count % g_options.hash_every == 0) {
+            char hash[24];
+            snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)g_last_frame_hash);
+            std::cerr << "[Hash] Frame " << g_vsync_count << " " << hash << "\n";
+        }
+        if (g_turbo_allowed) {
+            update_turbo();
+        }
+    }
+    if (skipped) {
+        return;
+    }
+    
+    // Mark buffer ready for swap and wake the renderer
+    g_frame_width.store(ACTIVE_WIDTH, std::memory_order_relaxed);
+    g_frame_height.store(ACTIVE_HEIGHT, std::memory_order_relaxed);
+    g_published_frame.store(g_vsync_count, std::memory_order_relaxed);
+    buffer_swap_pending.store(true, std::memory_order_release);
+    notify_frame_ready();
+}
+
+// read VGA outputs and update graphics buffer (generic path, any timing)
+void sample_pixel(uint32_t sample) {
+    SyncMonitor& mon = g_sync_monitor;
+    uint64_t at = mon.samples++;
+    bool h_sync = (sample & SAMPLE_H_SYNC) != 0;
+    bool v_sync = (sample & SAMPLE_V_SYNC) != 0;
+    
+    coord_x = (coord_x + 1) % TOTAL_WIDTH;
+
+    if(h_sync != pre_h_sync){
+        if(h_sync){ // start of h_sync pulse
+            coord_x = 0;
+            coord_y = (coord_y + 1) % TOTAL_HEIGHT;
+            mon.h_lead(at, pre_v_sync);
+        } else {
+            mon.h_trail(at);
+        }
+    }
+
+    if(v_sync != pre_v_sync){
+        if(v_sync){ // start of v_sync pulse
+            coord_y = 0;
+            mon.v_lead(at);
+            finish_frame();
+        } else {
+            mon.v_trail(at);
+        }
+    }
+    
+    if((sample & 0xFFFF) && (coord_x < mon.x0 || coord_x >= mon.x1 || coord_y < mon.y0 || coord_y >= mon.y1)){
+        mon.blank_pixel(coord_x, coord_y, 1);
+    }
+
+    if(!g_frame_skipped && coord_x >= H_ACTIVE_START && coord_x < H_ACTIVE_START + ACTIVE_WIDTH && 
+       coord_y >= V_ACTIVE_START && coord_y < V_ACTIVE_START + ACTIVE_HEIGHT){
+        int x_index = coord_x - H_ACTIVE_START;
+        int y_index = coord_y - V_ACTIVE_START;
+        uint16_t rgb = (uint16_t)sample;
+        g_frame_hash = (g_frame_hash ^ rgb) * FNV_PRIME;
+        uint16_t* buf = write_buffer.load(std::memory_order_relaxed);
+        buf[y_index * ACTIVE_WIDTH + x_index] = rgb;
+    }
+
+    pre_h_sync = h_sync;
+    pre_v_sync = v_sync;
+}
+
+void sample_batch_generic(const uint32_t* samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        sample_pixel(samples[i]);
+    }
+}
+
+// Scanline sampler specialised on VESA_MODES[MODE]. Processes the samples
+// s[0..q-p) at line positions p..q-1 of one line. Returns false without side
+// effects if the sync pulses are not exactly where the mode puts them; the
+// caller then falls back to sample_pixel(), which re-locks on the next edge.
+template <int MODE>
+inline bool sample_span_fast(const uint32_t* s, int p, int q) {
+    constexpr VgaTiming M = VESA_MODES[MODE];
+    constexpr int H_SYNC = M.h_sync;
+    constexpr int H_START = M.h_start();
+    constexpr int H_END = M.h_start() + M.h_active;
+    constexpr int V_START = M.v_start();
+    static_assert(H_START >= H_SYNC && H_END <= M.h_total(), "active window overlaps h_sync");
+    static_assert(M.h_active <= MAX_ACTIVE_WIDTH && M.v_active <= MAX_ACTIVE_HEIGHT, "mode exceeds framebuffer");
+    
+    // 1. Lock check: h_sync leading edge at position 0, pulse over [0, H_SYNC),
+    //    no pulse afterwards, and v_sync only changing at position 0
+    int i = 0;
+    uint32_t v_line = pre_v_sync ? SAMPLE_V_SYNC : 0;
+    if (p == 0) {
+        if (!(s[0] & SAMPLE_H_SYNC) || pre_h_sync) return false;
+        v_line = s[0] & SAMPLE_V_SYNC;
+        i = 1;
+    }
+    int n = q - p;
+    int pulse_end = H_SYNC - p;
+    if (pulse_end < i) pulse_end = i;
+    if (pulse_end > n) pulse_end = n;
+    // The rest of the span is split at the active window so the same pass
+    // collects the blanking rgb for the sync monitor
+    int act_begin = H_START - p < pulse_end ? pulse_end : (H_START - p > n ? n : H_START - p);
+    int act_end = H_END - p < act_begin ? act_begin : (H_END - p > n ? n : H_END - p);
+    uint32_t pulse_and = ~0u, pulse_or = 0, rest_and = ~0u, blank_or = 0, active_or = 0;
+    for (int k = i; k < pulse_end; k++) {
+        pulse_and &= s[k];
+        pulse_or |= s[k];
+    }
+    for (int k = pulse_end; k < act_begin; k++) {
+        rest_and &= s[k];
+        blank_or |= s[k];
+    }
+    for (int k = act_begin; k < act_end; k++) {
+        rest_and &= s[k];
+        active_or |= s[k];
+    }
+    for (int k = act_end; k < n; k++) {
+        rest_and &= s[k];
+        blank_or |= s[k];
+    }
+    uint32_t rest_or = blank_or | active_or;
+    bool h_ok = (pulse_and & SAMPLE_H_SYNC) && !(rest_or & SAMPLE_H_SYNC);
+    bool v_ok = v_line ? ((pulse_and & rest_and) & SAMPLE_V_SYNC) != 0
+                       : ((pulse_or | rest_or) & SAMPLE_V_SYNC) == 0;
+    if (!h_ok || !v_ok) return false;
+    
+    // 2. Line start bookkeeping, as in sample_pixel()
+    SyncMonitor& mon = g_sync_monitor;
+    if (p == 0) {
+        coord_y = coord_y + 1 == M.v_total() ? 0 : coord_y + 1;
+        mon.h_lead(mon.samples, pre_v_sync);
+        if (v_line && !pre_v_sync) {
+            coord_y = 0;
+            mon.v_lead(mon.samples);
+            finish_frame();
+        } else if (!v_line && pre_v_sync) {
+            mon.v_trail(mon.samples);
+        }
+    }
+    if (p <= H_SYNC && H_SYNC < q) {
+        mon.h_trail(mon.samples + (H_SYNC - p));
+    }
+    
+    // 3. Copy the active part of the span; no per-pixel bounds or sync checks
+    unsigned row = (unsigned)(coord_y - V_START);
+    int x0 = p > H_START ? p : H_START;
+    int x1 = q < H_END ? q : H_END;
+    bool active_row = row < (unsigned)M.v_active;
+    
+    // Blanking must be black; find the offending pixels only if the OR says so
+    blank_or |= pulse_or | s[0];
+    if (!active_row) blank_or |= active_or;
+    if (blank_or & 0xFFFF) {
+        for (int k = 0; k < n; k++) {
+            int x = p + k;
+            if ((s[k] & 0xFFFF) && (!active_row || x < H_START || x >= H_END)) {
+                mon.blank_pixel(x, coord_y, 1);
+            }
+        }
+    }
+    
+    if (active_row && x0 < x1 && !g_frame_skipped) {
+        uint16_t* dst = write_buffer.load(std::memory_order_relaxed) + row * M.h_active - H_START;
+        const uint32_t* src = s - p;
+        uint64_t hash = g_frame_hash;
+        for (int x = x0; x < x1; x++) {
+            uint16_t rgb = (uint16_t)src[x];
+            dst[x] = rgb;
+            hash = (hash ^ rgb) * FNV_PRIME;
+        }
+        g_frame_hash = hash;
+    }
+    
+    coord_x = q - 1;
+    mon.samples += n;
+    pre_h_sync = (s[n - 1] & SAMPLE_H_SYNC) != 0;
+    pre_v_sync = (s[n - 1] & SAMPLE_V_SYNC) != 0;
+    return true;
+}
+
+template <int MODE>
+void sample_batch_fast(const uint32_t* s, size_t count) {
+    constexpr int H_TOTAL = VESA_MODES[MODE].h_total();
+    while (count > 0) {
+        int p = coord_x + 1 >= H_TOTAL ? 0 : coord_x + 1;
+        int n = H_TOTAL - p;
+        if ((size_t)n > count) n = (int)count;
+        bool locked = (p == 0 && n == H_TOTAL)
+            ? sample_span_fast<MODE>(s, 0, H_TOTAL)     // Whole line: all bounds are constants
+            : sample_span_fast<MODE>(s, p, p + n);
+        if (!locked) {
+            // Out of lock: generic path for this span
+            sample_batch_generic(s, n);
+        }
+        s += n;
+        count -= n;
+    }
+}
+
+typedef void (*SampleBatchFn)(const uint32_t* samples, size_t count);
+static SampleBatchFn g_sample_batch = sample_batch_generic;
+
+// Specialised sampler for a timing, or nullptr if it is not a VESA_MODES entry
+SampleBatchFn fast_sampler_for(const VgaTiming& t) {
+    static const SampleBatchFn fast[] = {
+        sample_batch_fast<0>, sample_batch_fast<1>, sample_batch_fast<2>, sample_batch_fast<3>,
+    };
+    static_assert(sizeof(fast) / sizeof(fast[0]) == NUM_VESA_MODES, "one fast sampler per VESA mode");
+    for (int i = 0; i < NUM_VESA_MODES; i++) {
+        const VgaTiming& m = VESA_MODES[i];
+        if (t.h_active == m.h_active && t.h_front == m.h_front && t.h_sync == m.h_sync &&
+            t.h_back == m.h_back && t.v_active == m.v_active && t.v_front == m.v_front &&
+            t.v_sync == m.v_sync && t.v_back == m.v_back) {
+            return fast[i];
+        }
+    }
+    return nullptr;
+}
+
+// Samples to collect per batch; in specialised modes batches end on a line boundary
+const int SAMPLE_BATCH = 1024;
+
+int next_batch_size() {
+    if (g_sample_batch == sample_batch_generic) return SAMPLE_BATCH;
+    int to_line_end = TOTAL_WIDTH - (coord_x + 1 >= TOTAL_WIDTH ? 0 : coord_x + 1);
+    return to_line_end + (SAMPLE_BATCH / TOTAL_WIDTH > 1 ? (SAMPLE_BATCH / TOTAL_WIDTH - 1) * TOTAL_WIDTH : 0);
+}
+
+// Switch the sampler to a timing mode (simulation thread only)
+void set_timing(const VgaTiming& timing, bool h_polarity, bool v_polarity) {
+    g_timing = timing;
+    g_h_sync_polarity = h_polarity;
+    g_v_sync_polarity = v_polarity;
+    H_ACTIVE_START = timing.h_start();
+    V_ACTIVE_START = timing.v_start();
+    ACTIVE_WIDTH = std::min(timing.h_active, MAX_ACTIVE_WIDTH);
+    ACTIVE_HEIGHT = std::min(timing.v_active, MAX_ACTIVE_HEIGHT);
+    TOTAL_WIDTH = timing.h_total();
+    TOTAL_HEIGHT = timing.v_total();
+    g_sync_invert = (h_polarity ? 0 : SAMPLE_H_SYNC) | (v_polarity ? 0 : SAMPLE_V_SYNC);
+    g_sync_monitor.x0 = timing.h_start();
+    g_sync_monitor.x1 = timing.h_start() + timing.h_active;
+    g_sync_monitor.y0 = timing.v_start();
+    g_sync_monitor.y1 = timing.v_start() + timing.v_active;
+    g_sync_monitor.restart();
+    g_sync_monitor.clear_interval(g_vsync_count + 1);
+    coord_x = 0;
+    coord_y = 0;
+    pre_h_sync = 0;
+    pre_v_sync = 0;
+    
+    SampleBatchFn fast = g_options.generic_sampler ? nullptr : fast_sampler_for(timing);
+    g_sample_batch = fast ? fast : sample_batch_generic;
+}
+
+// Measures sync periods, pulse widths and the active window over the first
+// frames. Fed once per clk cycle, so it also finds the clocks-per-pixel ratio.
+class TimingDetector {
+public:
+    // Returns true once two full v_sync periods and one full frame were seen
+    bool feed(bool h, bool v, uint16_t rgb) {
+        uint64_t t = m_tick++;
+        if (t == 0) {
+            m_prev_h = h;
+            m_prev_v = v;
+            m_prev_rgb = rgb;
+            return false;
+        }
+        bool h_changed = h != m_prev_h;
+        bool v_changed = v != m_prev_v;
+        if (h_changed || v_changed || rgb != m_prev_rgb) {
+            m_change_gcd = gcd(m_change_gcd, t - m_last_change);
+            m_last_change = t;
+        }
+        if (h_changed) {
+            if (m_h_changes > 0) m_h_run[m_prev_h] = t - m_h_last;
+            m_h_last = t;
+            m_h_changes++;
+        }
+        if (v_changed) {
+            if (m_v_changes > 0) m_v_run[m_prev_v] = t - m_v_last;
+            m_v_last = t;
+            m_v_changes++;
+        }
+        m_prev_h = h;
+        m_prev_v = v;
+        m_prev_rgb = rgb;
+        
+        // Phase 1: sync run lengths. The pulse is the shorter level of each signal.
+        if (m_phase == 0) {
+            if (m_v_changes >= 5 && m_h_run[0] && m_h_run[1] && m_v_run[0] && m_v_run[1]) {
+                m_h_pol = m_h_run[1] < m_h_run[0];
+                m_v_pol = m_v_run[1] < m_v_run[0];
+                m_phase = 1;
+            }
+            return false;
+        }
+        
+        // Phase 2: bounding box of non-black pixels over one frame, in clk cycles
+        // from the h_sync leading edge and lines from the v_sync leading edge
+        bool h_edge = h_changed && h == m_h_pol;
+        bool v_edge = v_changed && v == m_v_pol;
+        m_x++;
+        if (h_edge) {
+            m_x = 0;
+            m_line++;
+        }
+        if (v_edge) {
+            if (m_phase == 2) return true;
+            m_phase = 2;
+            m_line = 0;
+        }
+        if (m_phase == 2 && rgb != 0) {
+            m_x0 = std::min(m_x0, m_x);
+            m_x1 = std::max(m_x1, m_x);
+            m_y0 = std::min(m_y0, m_line);
+            m_y1 = std::max(m_y1, m_line);
+        }
+        return false;
+    }
+    
+    uint64_t ticks() const { return m_tick; }
+    
+    // Turn the measurements into a timing mode. Returns false if no sync was seen.
+    bool resolve(VgaTiming& timing, bool& h_pol, bool& v_pol, bool& vesa) const {
+        if (m_phase < 1) return false;
+        uint64_t h_period = m_h_run[0] + m_h_run[1];
+        uint64_t h_pulse = m_h_run[m_h_pol];
+        int v_total = (int)((m_v_run[0] + m_v_run[1] + h_period / 2) / h_period);
+        int v_pulse = (int)((m_v_run[m_v_pol] + h_period / 2) / h_period);
+        h_pol = m_h_pol;
+        v_pol = m_v_pol;
+        
+        // Known VESA mode at any supported clock ratio. Modes with the same totals
+        // (640x400@70 and 640x350@70) differ in the active window: take the
+        // smallest one that holds the picture, else the first.
+        int found = -1;
+        for (int i = 0; i < NUM_VESA_MODES; i++) {
+            const VgaTiming& m = VESA_MODES[i];
+            for (int d = 1; d <= 4; d *= 2) {
+                if (near(h_period, (uint64_t)m.h_total() * d, d) && near(h_pulse, (uint64_t)m.h_sync * d, d) &&
+                    v_total == m.v_total() && v_pulse == m.v_sync) {
+                    bool holds = m_y1 >= m_y0 && m_y0 >= m.v_start() && m_y1 < m.v_start() + m.v_active;
+                    bool found_holds = found >= 0 && m_y1 >= m_y0 && m_y0 >= timing.v_start() &&
+                                       m_y1 < timing.v_start() + timing.v_active;
+                    if (found < 0 || (holds && (!found_holds || m.v_active < timing.v_active))) {
+                        found = i;
+                        timing = m;
+                        timing.clocks_per_pixel = d;
+                    }
+                }
+            }
+        }
+        if (found >= 0) {
+            vesa = true;
+            return true;
+        }
+        
+        // Unknown mode: infer the pixel clock from the signal change granularity and
+        // the active window from the non-black area. Prefer the fastest pixel clock
+        // that keeps the line under MAX_INFERRED_H_TOTAL pixels.
+        const uint64_t MAX_INFERRED_H_TOTAL = 1100;
+        int d = 1;
+        while (d < 4 && (m_change_gcd % (2 * d)) == 0 && h_period / d > MAX_INFERRED_H_TOTAL) d *= 2;
+        static char name[32];
+        timing.clocks_per_pixel = d;
+        timing.h_sync = (int)(h_pulse / d);
+        timing.v_sync = v_pulse;
+        int h_total = (int)(h_period / d);
+        if (m_x1 >= m_x0 && m_y1 >= m_y0) {
+            int h_start = (int)(m_x0 / d);
+            timing.h_active = (int)(m_x1 / d) - h_start + 1;
+            timing.h_back = h_start - timing.h_sync;
+            timing.v_active = m_y1 - m_y0 + 1;
+            timing.v_back = m_y0 - v_pulse;
+        } else {
+            // Blank picture: assume the visible area spans everything after the pulse
+            timing.h_active = h_total - timing.h_sync;
+            timing.h_back = 0;
+            timing.v_active = v_total - v_pulse;
+            timing.v_back = 0;
+        }
+        timing.h_front = h_total - timing.h_active - timing.h_start();
+        timing.v_front = v_total - timing.v_active - timing.v_start();
+        snprintf(name, sizeof(name), "%dx%d", timing.h_active, timing.v_active);
+        timing.name = name;
+        vesa = false;
+        return true;
+    }
+    
+private:
+    static uint64_t gcd(uint64_t a, uint64_t b) {
+        while (b) { uint64_t r = a % b; a = b; b = r; }
+        return a;
+    }
+    static bool near(uint64_t a, uint64_t b, int tolerance) {
+        return (a > b ? a - b : b - a) <= (uint64_t)tolerance;
+    }
+    
+    uint64_t m_tick = 0;
+    bool m_prev_h = false, m_prev_v = false;
+    uint16_t m_prev_rgb = 0;
+    uint64_t m_last_change = 0, m_change_gcd = 0;
+    uint64_t m_h_last = 0, m_v_last = 0;
+    uint64_t m_h_run[2] = {0, 0}, m_v_run[2] = {0, 0};   // Last complete run per level
+    int m_h_changes = 0, m_v_changes = 0;
+    bool m_h_pol = true, m_v_pol = true;
+    int m_phase = 0;
+    uint64_t m_x = 0, m_x0 = UINT64_MAX, m_x1 = 0;
+    int m_line = 0, m_y0 = INT32_MAX, m_y1 = -1;
+};
+
+// Give up on detection after this many clk cycles (~10 frames of 640x480@60)
+const uint64_t MAX_DETECT_TICKS = 8000000;
+
+void print_timing(const char* how) {
+    const VgaTiming& t = g_timing;
+    std::cerr << "[Timing] " << how << " " << t.name
+              << " | " << t.clocks_per_pixel << " clk/pixel"
+              << " | h: " << t.h_total() << " px, sync " << t.h_sync << (g_h_sync_polarity ? " (+)" : " (-)")
+              << " | v: " << t.v_total() << " lines, sync " << t.v_sync << (g_v_sync_polarity ? " (+)" : " (-)")
+              << " | active " << t.h_active << "x" << t.v_active
+              << " at (" << t.h_start() << ", " << t.v_start() << ")\n";
+    if (t.h_active > MAX_ACTIVE_WIDTH || t.v_active > MAX_ACTIVE_HEIGHT) {
+        std::cerr << "[Timing] Active area clipped to " << ACTIVE_WIDTH << "x" << ACTIVE_HEIGHT << "\n";
+    }
+}
+
+// Run the design clk-by-clk until its timing is known, then configure the sampler
+void run_timing_detection() {
+    TimingDetector detector;
+    bool done = false;
+    while (!done && !design_finished() && !g_quit_requested.load(std::memory_order_acquire)) {
+        tick();
+        done = detector.feed(display->h_sync, display->v_sync, display->rgb);
+        if (detector.ticks() >= MAX_DETECT_TICKS) break;
+        if ((detector.ticks() & 0xFFFF) == 0) {
+            apply_input_events();
+        }
+    }
+    
+    VgaTiming timing;
+    bool h_pol, v_pol, vesa;
+    if (detector.resolve(timing, h_pol, v_pol, vesa)) {
+        set_timing(timing, h_pol, v_pol);
+        print_timing(vesa ? "Detected" : (done ? "Inferred" : "Inferred (partial)"));
+    } else {
+        set_timing(VESA_MODES[0], true, true);
+        print_timing("No stable sync after detection, assuming");
+    }
+}
+
+// Wake the renderer as soon as the LEDs change instead of at its idle timeout
+void notify_led_change() {
+    static int last_leds[5] = {1, 1, 1, 1, 1};
+    bool changed = false;
+    for (int i = 0; i < 5; i++) {
+        int led = leds_state[i].load(std::memory_order_relaxed);
+        if (led != last_leds[i]) {
+            last_leds[i] = led;
+            changed = true;
+        }
+    }
+    if (changed) {
+        notify_frame_ready();
+    }
+}
+
+// Thread placement (--sim-cpu/--render-cpu/--sched/--nice). Returns a description
+// of what was applied for the startup report; failures are reported, not fatal.
+std::string apply_thread_placement(int cpu, int fifo_priority, int nice_value) {
+    std::ostringstream desc;
+#if defined(__linux__)
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        desc << "CPU " << cpu << (err ? " (pinning failed: " + std::string(strerror(err)) + ")" : "");
+    } else {
+        desc << "any CPU";
+    }
+    if (fifo_priority > 0) {
+        sched_param param;
+        param.sched_priority = fifo_priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        desc << ", SCHED_FIFO " << fifo_priority
+             << (err ? " (failed: " + std::string(strerror(err)) + ", needs CAP_SYS_NICE)" : "");
+    }
+    if (nice_value != 0) {
+        // Linux applies nice per thread when given the thread id
+        int err = setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice_value);
+        desc << ", nice " << nice_value << (err ? " (failed: " + std::string(strerror(errno)) + ")" : "");
+    }
+#elif defined(_WIN32)
+    if (cpu >= 0) {
+        bool ok = cpu < (int)(sizeof(DWORD_PTR) * 8) &&
+                  SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+        desc << "CPU " << cpu << (ok ? "" : " (pinning failed)");
+    } else {
+        desc << "any CPU";
+    }
+    if (fifo_priority > 0 || nice_value < 0) {
+        bool ok = SetThreadPriority(GetCurrentThread(), fifo_priority > 0 ?
+            THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST) != 0;
+        desc << ", " << (fifo_priority > 0 ? "time-critical" : "high") << " priority" << (ok ? "" : " (failed)");
+    } else if (nice_value > 0) {
+        bool ok = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL) != 0;
+        desc << ", below-normal priority" << (ok ? "" : " (failed)");
+    }
+#else
+    desc << "any CPU";
+    if (cpu >= 0 || fifo_priority > 0 || nice_value != 0) {
+        desc << " (affinity/scheduling options are not supported on this platform)";
+    }
+#endif
+    return desc.str();
+}
+
+// The periodic yield only helps when both threads may share a core
+static bool g_sim_yield = true;
+
+void report_thread_placement(const std::string& sim_desc, const std::string& render_desc) {
+    const SimOptions& o = g_options;
+    g_sim_yield = !(o.sim_cpu >= 0 && o.render_cpu >= 0 && o.sim_cpu != o.render_cpu);
+    std::cerr << "[Sched] " << std::thread::hardware_concurrency() << " CPUs"
+              << " | sim thread: " << sim_desc
+              << " | render thread: " << render_desc
+              << " | periodic yield: " << (g_sim_yield ? "on" : "off") << "\n";
+}
+
+static std::string g_render_placement;  // Set by main() before the simulation thread starts
+
+
+// Sync-loss watchdog (--watchdog, --watchdog-frames). --watchdog is in simulated
+// milliseconds of the 50 MHz board clock.
+
+// Levels come from the last sampled pixel, not from the model: with --pipeline
+// this runs on the sampler thread while the model is evaluated further on.
+void print_watchdog_diagnostic(int code, uint64_t h_idle, uint64_t v_idle) {
+    bool h_high = pre_h_sync == g_h_sync_polarity;
+    bool v_high = pre_v_sync == g_v_sync_polarity;
+    std::ostringstream os;
+    switch (code) {
+        case EXIT_NO_H_SYNC:
+            os << "[Watchdog] No h_sync edge for " << h_idle << " clocks (" << h_idle / BOARD_CLOCKS_PER_MS
+               << " ms simulated), h_sync stuck " << (h_high ? "high" : "low") << "\n"
+               << "[Watchdog]   Check that the design leaves reset and that its pixel clock divider toggles\n";
+            break;
+        case EXIT_NO_V_SYNC:
+            os << "[Watchdog] h_sync toggles but no v_sync edge for " << v_idle << " clocks ("
+               << v_idle / BOARD_CLOCKS_PER_MS << " ms simulated), v_sync stuck " << (v_high ? "high" : "low") << "\n"
+               << "[Watchdog]   Check that the line counter advances at the end of each line and wraps at the frame total\n";
+            break;
+        case EXIT_FROZEN:
+            os << "[Watchdog] The image has not changed for " << (g_vsync_count - g_last_change_frame) << " frames\n"
+               << "[Watchdog]   Raise or disable --watchdog-frames for designs that show a still image\n";
+            break;
+    }
+    char hash[24];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)g_last_frame_hash);
+    os << "[Watchdog] Stopped after " << g_vsync_count << " frames and " << sample_time() / 2
+       << " clocks in " << g_timing.name << ", last frame hash " << hash << ", exit code " << code << "\n";
+    std::cerr << os.str();
+}
+
+// Called by the simulation thread after every batch. Interactive runs only
+// toggle the "NO SIGNAL" indicator; batch runs (--headless or --frames) return
+// the exit code to stop with, or 0 to keep going.
+int check_watchdog() {
+    const SyncMonitor& mon = g_sync_monitor;
+    uint64_t limit = (uint64_t)g_options.watchdog_ms * BOARD_CLOCKS_PER_MS;
+    uint64_t h_idle = (mon.samples - mon.h_seen_at) * g_timing.clocks_per_pixel;
+    uint64_t v_idle = (mon.samples - mon.v_seen_at) * g_timing.clocks_per_pixel;
+    int code = 0;
+    if (limit > 0 && h_idle >= limit) {
+        code = EXIT_NO_H_SYNC;
+    } else if (limit > 0 && v_idle >= limit) {
+        code = EXIT_NO_V_SYNC;
+    }
+    
+    if (!g_options.headless && g_options.frames == 0) {
+        bool no_signal = code != 0;
+        if (no_signal != g_no_signal.load(std::memory_order_relaxed)) {
+            g_no_signal.store(no_signal, std::memory_order_relaxed);
+            std::cerr << (no_signal ? "[Watchdog] No signal\n" : "[Watchdog] Signal back\n");
+            notify_frame_ready();
+        }
+        return 0;
+    }
+    if (code == 0 && g_options.watchdog_frames > 0 &&
+        g_vsync_count - g_last_change_frame >= (uint64_t)g_options.watchdog_frames) {
+        code = EXIT_FROZEN;
+    }
+    if (code != 0) {
+        print_watchdog_diagnostic(code, h_idle, v_idle);
+    }
+    return code;
+}
+
+// Map a button label (RESET, B2..B5, case-insensitive) to its keys[] index
+int parse_button(const std::string& name) {
+    for (int i = 0; i < 5; i++) {
+        if (SDL_strcasecmp(name.c_str(), g_buttons[i].label) == 0) return i;
+    }
+    return -1;
+}
+
+// Scripted button edges (--input-script) for reproducible headless runs. One
+// edge per line: "FRAME BUTTON press|release", e.g. "120 B2 press"; '#' starts
+// a comment. Edges take effect at the end of the batch in which frame FRAME
+// has been completed, in file order.
+struct ScriptedInput {
+    uint64_t frame;
+    uint8_t key_index;
+    uint8_t pressed;      // 1 = pressed (signal low), 0 = released
+};
+static std::vector<ScriptedInput> g_input_script;
+static size_t g_input_script_next = 0;      // Simulation (sampler) thread only
+
+bool load_input_script(const std::string& path, std::string& error) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string frame, button, action;
+        if (!(fields >> frame)) continue;   // Blank or comment line
+        fields >> button >> action;
+        ScriptedInput ev;
+        char* end = nullptr;
+        ev.frame = strtoull(frame.c_str(), &end, 10);
+        int key = parse_button(button);
+        bool known_action = action == "press" || action == "release";
+        if (*end != '\0' || key < 0 || !known_action) {
+            std::ostringstream os;
+            os << path << ":" << line_no << ": expected \"FRAME RESET|B2|B3|B4|B5 press|release\"";
+            error = os.str();
+            return false;
+        }
+        ev.key_index = (uint8_t)key;
+        ev.pressed = action == "press" ? 1 : 0;
+        if (!g_input_script.empty() && ev.frame < g_input_script.back().frame) {
+            std::ostringstream os;
+            os << path << ":" << line_no << ": frame " << ev.frame << " is before the previous edge";
+            error = os.str();
+            return false;
+        }
+        g_input_script.push_back(ev);
+    }
+    return true;
+}
+
+// Apply the scripted edges that are due. Like live input, a key changes at most
+// once per batch so a press and its release on the same frame are both seen.
+void apply_input_script() {
+    unsigned changed = 0;
+    while (g_input_script_next < g_input_script.size()) {
+        const ScriptedInput& ev = g_input_script[g_input_script_next];
+        unsigned bit = 1u << ev.key_index;
+        if (ev.frame > g_vsync_count || (changed & bit)) {
+            break;
+        }
+        g_input_script_next++;
+        changed |= bit;
+        keys[ev.key_index].store(ev.pressed ? 0 : 1, std::memory_order_relaxed);
+        if (ev.key_index == 0 && ev.pressed) {
+            restart_triggered.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+// Take the probe names from a freshly started plugin and start a new history
+// (simulation thread). The CSV gets a new header when the columns change.
+void init_probes() {
+    SignalProbes& p = g_signal_probes;
+    std::vector<std::string> names;
+    int count = g_design.api->probe_count(g_design.instance);
+    for (int i = 0; i < count; i++) {
+        const char* name = g_design.api->probe_name(g_design.instance, i);
+        names.push_back(name ? name : "probe" + std::to_string(i));
+    }
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        p.names = names;
+        p.values.assign(PROBE_HISTORY * names.size(), 0);
+        p.frames.assign(PROBE_HISTORY, 0);
+        p.samples = 0;
+        p.filled = 0;
+    }
+    p.count = names.size();
+    p.scratch.assign(names.size(), 0);
+    p.last_frame = ~0ULL;
+    p.last_line = -1;
+    if (names.empty()) {
+        if (!g_options.probe_csv.empty()) {
+            std::cerr << "[Probes] The design has no probes for --probe-csv; list signals in probes.txt\n";
+        }
+        return;
+    }
+    std::cerr << "[Probes] " << names.size() << " signal(s), sampled once per "
+              << (g_options.probe_per_line ? "line" : "frame") << "\n";
+    if (g_options.probe_csv.empty() || names == p.csv_names) return;
+    if (!p.csv.is_open()) {
+        p.csv.open(g_options.probe_csv.c_str(), std::ios::trunc);
+        if (!p.csv) {
+            std::cerr << "[Probes] Cannot write " << g_options.probe_csv << "\n";
+            g_options.probe_csv.clear();
+            return;
+        }
+    }
+    p.csv << "frame,line,clock";
+    for (size_t i = 0; i < names.size(); i++) {
+        p.csv << "," << names[i];
+    }
+    p.csv << "\n";
+    p.csv_names = names;
+}
+
+// Read the probes once the frame (or line, --probe-every=line) has moved on
+// since the last sample; called after every batch when the design has probes
+void sample_probes() {
+    SignalProbes& p = g_signal_probes;
+    if (g_vsync_count == p.last_frame && (!g_options.probe_per_line || coord_y == p.last_line)) {
+        return;
+    }
+    p.last_frame = g_vsync_count;
+    p.last_line = coord_y;
+    g_design.api->read_probes(g_design.instance, p.scratch.data());
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        size_t slot = (size_t)(p.samples % PROBE_HISTORY);
+        std::copy(p.scratch.begin(), p.scratch.end(), p.values.begin() + slot * p.count);
+        p.frames[slot] = g_vsync_count;
+        p.samples++;
+        p.filled = std::min(p.filled + 1, PROBE_HISTORY);
+    }
+    if (p.csv.is_open()) {
+        p.csv << g_vsync_count << "," << coord_y << "," << main_time / 2;
+        for (size_t i = 0; i < p.count; i++) {
+            p.csv << "," << p.scratch[i];
+        }
+        p.csv << "\n";
+        p.csv_rows++;
+    }
+}
+
+// After a rewind: forget the samples from frame `frame` on, they are simulated again
+void trim_probe_history(uint64_t frame) {
+    SignalProbes& p = g_signal_probes;
+    std::lock_guard<std::mutex> lock(p.mutex);
+    while (p.filled > 0 && p.frames[(size_t)((p.samples - 1) % PROBE_HISTORY)] >= frame) {
+        p.samples--;
+        p.filled--;
+    }
+    p.last_frame = ~0ULL;
+    p.last_line = -1;
+}
+
+// Hand the open block over to the render thread and start the next one where
+// it ended; the oldest blocks go beyond the --analyzer budget
+void analyzer_hand_over() {
+    LogicAnalyzer& a = g_analyzer;
+    a.handed_frame = g_vsync_count;
+    a.handed_time = a.last;
+    AnalyzerBlock next;
+    next.start = a.last_entry;
+    next.clocks_per_pixel = g_timing.clocks_per_pixel;
+    next.before = a.levels;
+    std::lock_guard<std::mutex> lock(a.mutex);
+    a.end = std::max(a.last, a.last_entry);
+    if (a.open.entries.empty()) {
+        a.open = next;
+        return;
+    }
+    a.open.entries.shrink_to_fit();
+    a.bytes += sizeof(AnalyzerBlock) + a.open.entries.size() * sizeof(uint32_t);
+    a.blocks.push_back(std::move(a.open));
+    a.open = next;
+    while (a.bytes > a.budget && a.blocks.size() > 1) {
+        a.bytes -= sizeof(AnalyzerBlock) + a.blocks.front().entries.size() * sizeof(uint32_t);
+        a.blocks.pop_front();
+    }
+}
+
+// Time went back to board clock t (a rewind or a restarted design): forget
+// everything from t on, it is simulated again
+void analyzer_truncate(uint64_t t) {
+    LogicAnalyzer& a = g_analyzer;
+    std::lock_guard<std::mutex> lock(a.mutex);
+    a.end = std::min(a.end, t);
+    if (a.open.start >= t) {
+        while (!a.blocks.empty() && a.blocks.back().start >= t) {
+            a.bytes -= sizeof(AnalyzerBlock) + a.blocks.back().entries.size() * sizeof(uint32_t);
+            a.blocks.pop_back();
+        }
+        if (a.blocks.empty()) {
+            a.open = AnalyzerBlock();
+            a.started = false;
+            a.end = 0;
+            return;
+        }
+        a.bytes -= sizeof(AnalyzerBlock) + a.blocks.back().entries.size() * sizeof(uint32_t);
+        a.open = std::move(a.blocks.back());
+        a.blocks.pop_back();
+    }
+    uint64_t at = a.open.start;
+    uint16_t levels = a.open.before;
+    size_t k = 0;
+    for (; k < a.open.entries.size(); k++) {
+        uint64_t next = at + analyzer_run(a.open.entries[k]) * a.open.clocks_per_pixel;
+        if (next >= t) break;
+        at = next;
+        levels = analyzer_levels(a.open.entries[k]);
+    }
+    a.open.entries.resize(k);
+    a.last_entry = at;
+    a.levels = levels;
+}
+
+// Record one batch of samples, one per pixel clock, ending at the current
+// sample time. Only samples that differ from the one before are decoded.
+void analyzer_feed(const uint32_t* s, size_t count) {
+    LogicAnalyzer& a = g_analyzer;
+    if (!a.enabled || count == 0) return;
+    uint64_t cpp = (uint64_t)g_timing.clocks_per_pixel;
+    uint64_t end = sample_time() / 2;
+    uint64_t t = end > (count - 1) * cpp ? end - (count - 1) * cpp : 0;
+    if (a.started && t <= a.last) {
+        analyzer_truncate(t);
+    }
+    bool fresh = !a.started;
+    if (fresh) {
+        a.open = AnalyzerBlock();
+        a.open.start = t;
+        a.open.clocks_per_pixel = (int)cpp;
+        a.last_entry = t;
+        a.first = t;
+        a.handed_time = t;
+        a.started = true;
+    } else if (a.open.clocks_per_pixel != (int)cpp) {
+        // New mode: the runs of a block count pixels of one size
+        analyzer_hand_over();
+        a.open.start = a.last_entry = a.last;
+    }
+    
+    // The buttons are applied between batches; they stay put within one
+    uint16_t inputs = 0;
+    for (int i = 0; i < 5; i++) {
+        inputs |= (uint16_t)((keys[i].load(std::memory_order_relaxed) & 1) << (LANE_RESET + i));
+    }
+    uint32_t raw = ~0u;     // No sample looks like this
+    for (size_t i = 0; i < count; i++, t += cpp) {
+        if (s[i] == raw) continue;
+        raw = s[i];
+        uint32_t pins = raw ^ g_sync_invert;
+        uint16_t levels = inputs |
+                          (pins & SAMPLE_H_SYNC ? 1 << LANE_H_SYNC : 0) |
+                          (pins & SAMPLE_V_SYNC ? 1 << LANE_V_SYNC : 0) |
+                          (raw & 0xF800 ? 1 << LANE_RED : 0) |
+                          (raw & 0x07E0 ? 1 << LANE_GREEN : 0) |
+                          (raw & 0x001F ? 1 << LANE_BLUE : 0);
+        if (fresh) {
+            a.open.before = a.levels = levels;
+            fresh = false;
+        }
+        if (levels == a.levels) continue;
+        if (a.open.entries.size() >= ANALYZER_BLOCK_ENTRIES) {
+            analyzer_hand_over();
+        }
+        uint64_t run = (t - a.last_entry) / cpp;
+        for (; run > ANALYZER_MAX_RUN; run -= ANALYZER_MAX_RUN) {
+            a.open.entries.push_back(ANALYZER_MAX_RUN << ANALYZER_LANES | a.levels);
+        }
+        a.open.entries.push_back((uint32_t)run << ANALYZER_LANES | levels);
+        a.last_entry = t;
+        a.levels = levels;
+        a.edges++;
+    }
+    a.last = end;
+}
+
+// Every sampled batch goes through here: the logic analyzer sees it first
+inline void sample_batch(const uint32_t* samples, size_t count) {
+    analyzer_feed(samples, count);
+    g_sample_batch(samples, count);
+}
+
+// Sampling-side work after every batch: apply queued and scripted input, wake the renderer
+// for LED changes and end batch runs after --frames frames or when the watchdog gives up
+void finish_batch() {
+    if (!g_pipelined) {
+        apply_input_events();   // run_pipelined() applies them on the eval thread
+    } else if (g_probe.state.load(std::memory_order_acquire) == PROBE_ARMED &&
+               g_sampled_time >= g_probe.apply_time) {
+        probe_take_baseline();
+    }
+    apply_input_script();
+    notify_led_change();
+    probe_check_leds();
+    if (g_signal_probes.count > 0 && !g_pipelined) {
+        sample_probes();    // The --pipeline sampler thread must not touch the model
+    }
+    if (g_analyzer.started && (g_vsync_count != g_analyzer.handed_frame ||
+                               g_analyzer.last - g_analyzer.handed_time >= ANALYZER_MAX_SPAN / 4)) {
+        analyzer_hand_over();   // Once a frame, or every 21 ms of board time without v_sync
+    }
+    
+    int watchdog_code = check_watchdog();
+    bool batch_run = g_options.headless || g_options.frames > 0;
+    if (watchdog_code != 0) {
+        g_exit_code.store(watchdog_code, std::memory_order_relaxed);
+        g_quit_requested.store(true, std::memory_order_release);
+    } else if (g_check_failed && batch_run) {
+        char hash[24];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)g_last_frame_hash);
+        std::cerr << "[Check] Stopped after " << g_vsync_count << " frames and " << sample_time() / 2
+                  << " clocks, last frame hash " << hash << ", exit code " << EXIT_CHECK_FAILED << "\n";
+        g_exit_code.store(EXIT_CHECK_FAILED, std::memory_order_relaxed);
+        g_quit_requested.store(true, std::memory_order_release);
+    } else if (g_options.frames > 0 && g_vsync_count >= g_options.frames) {
+        char hash[24];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)g_last_frame_hash);
+        std::cerr << "[Batch] " << g_vsync_count << " frames done, last frame hash " << hash << "\n";
+        g_quit_requested.store(true, std::memory_order_release);
+    }
+}
+
+// Pause and step state (simulation thread). While a step or run-until command
+// is active, batches are cut so the last sample is exactly where it stops.
+struct DebugState {
+    bool paused = false;
+    int step = DEBUG_NONE;          // Active step / run-until command
+    uint64_t remaining = 0;         // DEBUG_STEP_CYCLES / LINE: pixels left
+    uint64_t target = 0;            // Frame, clock cycle or vsync count the command waits for
+    int pixel_x = 0, pixel_y = 0;   // DEBUG_UNTIL_PIXEL: line position of the watched pixel
+    int pixel_value = -1;           // Its rgb in the last frame (-1 = not seen yet)
+    int leds = 0;                   // DEBUG_UNTIL_LED: LEDs when the command started
+};
+static DebugState g_debug;
+
+int led_bits() {
+    int bits = 0;
+    for (int i = 0; i < 5; i++) {
+        bits = bits << 1 | (leds_state[i].load(std::memory_order_relaxed) ? 1 : 0);
+    }
+    return bits;
+}
+
+// Samples until the line position (x, y) is sampled next time, 1..one frame
+uint64_t pixels_to(int x, int y) {
+    int64_t frame = (int64_t)TOTAL_WIDTH * TOTAL_HEIGHT;
+    int64_t d = ((int64_t)(y - coord_y) * TOTAL_WIDTH + (x - coord_x)) % frame;
+    return (uint64_t)(d <= 0 ? d + frame : d);
+}
+
+void print_debug_position(const char* what) {
+    int leds = led_bits();
+    std::cerr << "[Debug] " << what << " at frame " << g_vsync_count << ", line " << coord_y << ", pixel "
+              << coord_x << " (active " << coord_x - H_ACTIVE_START << ", " << coord_y - V_ACTIVE_START
+              << "), clock " << main_time / 2 << ", LEDs ";
+    for (int i = 4; i >= 0; i--) {
+        std::cerr << ((leds >> i) & 1);
+    }
+    std::cerr << "\n";
+}
+
+void debug_pause(const char* why) {
+    g_debug.step = DEBUG_NONE;
+    if (g_options.headless) {
+        // Nobody can resume a headless run; a reached --run-until ends it
+        print_debug_position(why);
+        g_quit_requested.store(true, std::memory_order_release);
+        return;
+    }
+    g_debug.paused = true;
+    g_debug_paused.store(true, std::memory_order_relaxed);
+    if (g_analyzer.started) {
+        analyzer_hand_over();   // Show the samples up to where it stopped
+    }
+    print_debug_position(why);
+    notify_frame_ready();
+}
+
+void clear_checkpoints() {
+    g_rewind.ring.clear();
+    g_rewind.inputs.clear();
+    g_rewind.last_inputs = -1;
+    g_rewind.bytes = 0;
+    g_rewind.next_frame = g_vsync_count;
+}
+
+// Snapshot the model and the sampling state; called between batches
+void take_checkpoint() {
+    int64_t start_ns = steady_now_ns();
+    Checkpoint c;
+    size_t size = 0;
+    const uint8_t* data = g_design.api->save_state(g_design.instance, &size);
+    c.model.assign(data, data + size);
+    c.frame = g_vsync_count;
+    c.first_full_frame = g_vsync_count + (coord_y < V_ACTIVE_START ? 1 : 2);
+    c.time = main_time;
+    c.ports = *display;
+    c.coord_x = coord_x;
+    c.coord_y = coord_y;
+    c.pre_h_sync = pre_h_sync;
+    c.pre_v_sync = pre_v_sync;
+    c.monitor = g_sync_monitor;
+    c.frame_hash = g_frame_hash;
+    c.last_frame_hash = g_last_frame_hash;
+    c.last_change_frame = g_last_change_frame;
+    g_rewind.bytes += sizeof(Checkpoint) + size;
+    g_rewind.ring.push_back(std::move(c));
+    
+    // Stay within the budget; keep the inputs from the oldest checkpoint on
+    size_t budget = (size_t)g_options.checkpoint_mb << 20;
+    while (g_rewind.bytes > budget && g_rewind.ring.size() > 1) {
+        g_rewind.bytes -= sizeof(Checkpoint) + g_rewind.ring.front().model.size();
+        g_rewind.ring.pop_front();
+    }
+    while (!g_rewind.inputs.empty() && g_rewind.inputs.front().time < g_rewind.ring.front().time) {
+        g_rewind.inputs.pop_front();
+    }
+    g_rewind.next_frame = g_vsync_count + g_options.checkpoint_every;
+    
+    int64_t ns = steady_now_ns() - start_ns;
+    if (g_rewind.saves++ == 0) {
+        std::cerr << "[Rewind] First checkpoint: " << size / 1024 << " KB in " << ns / 1000 << " us\n";
+    }
+    g_rewind.save_ns_sum += ns;
+    g_rewind.save_ns_max = std::max(g_rewind.save_ns_max, ns);
+}
+
+// Go back `frames` frames from the last finished one: restore the newest
+// checkpoint before the target, re-simulate up to it with the logged inputs
+// without drawing, show it and pause. The discarded future is forgotten.
+void rewind_frames(uint64_t frames) {
+    if (!g_rewind.enabled || g_rewind.ring.empty()) {
+        std::cerr << (g_rewind.enabled ? "[Rewind] No checkpoint yet\n"
+                      : "[Rewind] Checkpoints are off (batch run, --diff or --checkpoint-every=0)\n");
+        return;
+    }
+    int64_t start_ns = steady_now_ns();
+    uint64_t target = g_vsync_count > frames ? g_vsync_count - frames : 0;
+    if (target < g_rewind.ring.front().first_full_frame) {
+        target = g_rewind.ring.front().first_full_frame;
+        std::cerr << "[Rewind] Going back to frame " << target << ", the oldest one still in memory\n";
+    }
+    while (g_rewind.ring.size() > 1 && g_rewind.ring.back().first_full_frame > target) {
+        g_rewind.bytes -= sizeof(Checkpoint) + g_rewind.ring.back().model.size();
+        g_rewind.ring.pop_back();
+    }
+    const Checkpoint& c = g_rewind.ring.back();
+    uint64_t now_time = main_time;
+    if (g_design.api->restore_state(g_design.instance, c.model.data(), c.model.size()) != 0) {
+        std::cerr << "[Rewind] The design could not restore its checkpoint\n";
+        return;
+    }
+    main_time = c.time;
+    *display = c.ports;
+    set_keys(input_bits());
+    update_leds();
+    coord_x = c.coord_x;
+    coord_y = c.coord_y;
+    pre_h_sync = c.pre_h_sync;
+    pre_v_sync = c.pre_v_sync;
+    g_sync_monitor = c.monitor;
+    g_vsync_count = c.frame;
+    g_frame_hash = c.frame_hash;
+    g_last_frame_hash = c.last_frame_hash;
+    g_last_change_frame = c.last_change_frame;
+    g_frame_skipped = c.frame + 1 < target;
+    
+    // Re-simulate, applying each logged input change at its own time
+    uint32_t batch[SAMPLE_BATCH + 2048];
+    std::deque<InputRecord>::iterator next = g_rewind.inputs.begin();
+    while (next != g_rewind.inputs.end() && next->time < main_time) ++next;
+    g_rewind.replaying = true;
+    g_replay_target = target;
+    uint64_t ticks_per_pixel = 2 * (uint64_t)g_timing.clocks_per_pixel;
+    while (g_vsync_count < target && main_time < now_time) {
+        if (next != g_rewind.inputs.end() && next->time <= main_time) {
+            if (next->inputs == INPUT_RESET) {
+                reset();
+            } else {
+                set_keys(next->inputs);
+            }
+            ++next;
+            continue;
+        }
+        uint64_t n = next_batch_size();
+        if (next != g_rewind.inputs.end()) {
+            n = std::min(n, std::max<uint64_t>(1, (next->time - main_time) / ticks_per_pixel));
+        }
+        if (g_vsync_count + 1 >= target) {
+            n = std::min(n, pixels_to(0, 0));   // Stop right after the target frame is finished
+        }
+        run_pixels(batch, (int)n);
+        sample_batch(batch, (int)n);
+    }
+    g_rewind.replaying = false;
+    g_replay_target = 0;
+    g_rewind.inputs.erase(next, g_rewind.inputs.end());
+    g_rewind.last_inputs = input_bits();
+    g_rewind.next_frame = c.frame + g_options.checkpoint_every;
+    trim_probe_history(g_vsync_count);
     
-    // Clear graphics buffers
-    std::memset(buffer_a, 0, sizeof(buffer_a));
-    std::memset(buffer_b, 0, sizeof(buffer_b));
-     
-    // Reset VGA signal tracking variables
-    coord_x = 0;
-    coord_y = 0;
-    pre_h_sync = 0;
-    pre_v_sync = 0;
+    double ms = (steady_now_ns() - start_ns) / 1e6;
+    char cost[64];
+    snprintf(cost, sizeof(cost), "%.1f ms", ms);
+    std::cerr << "[Rewind] Restored the checkpoint of frame " << c.frame << " and re-simulated "
+              << g_vsync_count - c.frame << " frames in " << cost << "\n";
+    debug_pause(g_vsync_count == target ? "Rewound" : "Rewind stopped early");
+}
+
+// Checkpoint cost for the final report
+void print_rewind_stats(double sim_seconds) {
+    if (g_rewind.saves == 0) return;
+    size_t per = g_rewind.ring.empty() ? 0 : g_rewind.ring.back().model.size();
+    char text[160];
+    snprintf(text, sizeof(text), "%llu checkpoints of %zu KB, %lld us avg / %lld us max each (%.3f%% of run time)",
+             (unsigned long long)g_rewind.saves, per / 1024,
+             (long long)(g_rewind.save_ns_sum / (int64_t)g_rewind.saves / 1000),
+             (long long)(g_rewind.save_ns_max / 1000),
+             sim_seconds > 0 ? g_rewind.save_ns_sum / 1e9 / sim_seconds * 100 : 0.0);
+    std::cerr << "Rewind checkpoints:  " << text << "\n";
+    if (!g_rewind.ring.empty()) {
+        std::cerr << "Rewind ring:         frames " << g_rewind.ring.front().frame << "-" << g_rewind.ring.back().frame
+                  << " in " << g_rewind.ring.size() << " checkpoints, " << g_rewind.bytes / 1024 << " KB, "
+                  << g_rewind.inputs.size() << " input changes\n";
+    }
+}
+
+// Logic analyzer storage for the final report
+void print_analyzer_stats() {
+    LogicAnalyzer& a = g_analyzer;
+    if (!a.started) return;
+    double seconds = (a.last - a.first) / (BOARD_CLOCKS_PER_MS * 1000.0);
+    std::lock_guard<std::mutex> lock(a.mutex);
+    char text[160];
+    snprintf(text, sizeof(text), "%llu edges, %zu KB kept in %zu blocks, %.0f KB per simulated second",
+             (unsigned long long)a.edges, a.bytes / 1024, a.blocks.size(),
+             seconds > 0 ? a.edges * sizeof(uint32_t) / 1024.0 / seconds : 0.0);
+    std::cerr << "Logic analyzer:      " << text << "\n";
+}
+
+// Take the posted command, if any
+void take_debug_command() {
+    int command;
+    uint64_t arg;
+    {
+        std::lock_guard<std::mutex> lock(g_debug_mutex);
+        command = g_debug_command;
+        arg = g_debug_arg;
+        g_debug_command = DEBUG_NONE;
+        g_debug_pending.store(false, std::memory_order_relaxed);
+    }
+    if (command == DEBUG_NONE) return;
+    if (command == DEBUG_PAUSE) {
+        if (g_debug.paused && g_debug.step == DEBUG_NONE) {
+            g_debug.paused = false;
+            g_debug_paused.store(false, std::memory_order_relaxed);
+            std::cerr << "[Debug] Running\n";
+            notify_frame_ready();
+        } else {
+            debug_pause("Paused");
+        }
+        return;
+    }
+    if (command == DEBUG_REWIND) {
+        rewind_frames(arg);
+        return;
+    }
+    g_debug.step = command;
+    switch (command) {
+        case DEBUG_STEP_FRAME:
+            g_debug.target = g_vsync_count + 1;
+            break;
+        case DEBUG_STEP_LINE:
+            g_debug.remaining = pixels_to(0, (coord_y + 1) % TOTAL_HEIGHT);
+            break;
+        case DEBUG_STEP_CYCLES:
+            g_debug.remaining = (arg + g_timing.clocks_per_pixel - 1) / g_timing.clocks_per_pixel;
+            break;
+        case DEBUG_UNTIL_LED:
+            g_debug.leds = led_bits();
+            break;
+        case DEBUG_UNTIL_PIXEL: {
+            int x = (int)(arg >> 32);
+            int y = (int)(uint32_t)arg;
+            if (x < 0 || x >= ACTIVE_WIDTH) x = ACTIVE_WIDTH / 2;
+            if (y < 0 || y >= ACTIVE_HEIGHT) y = ACTIVE_HEIGHT / 2;
+            g_debug.pixel_x = H_ACTIVE_START + x;
+            g_debug.pixel_y = V_ACTIVE_START + y;
+            g_debug.pixel_value = -1;
+            std::cerr << "[Debug] Running until pixel (" << x << ", " << y << ") changes\n";
+            break;
+        }
+        case DEBUG_UNTIL_FRAME:
+        case DEBUG_UNTIL_CYCLE:
+            g_debug.target = arg;
+            break;
+    }
+}
+
+// Cut a batch so that it ends on the clock of the next waiting button edge
+int input_batch_size(int n) {
+    uint64_t due = g_input_schedule.due;
+    uint64_t now = main_time / 2;
+    if (due <= now) return n;
+    uint64_t pixel = (uint64_t)std::max(1, g_timing.clocks_per_pixel);
+    return (int)std::min<uint64_t>(n, (due - now + pixel - 1) / pixel);
+}
+
+// Batch size while paused or stepping; blocks while paused. Returns 0 when
+// the caller should re-check quit, reload and reset before asking again.
+int debug_batch_size(int normal) {
+    if (g_debug_pending.load(std::memory_order_acquire)) {
+        take_debug_command();
+    }
+    if (g_debug.paused && g_debug.step == DEBUG_NONE) {
+        {
+            std::unique_lock<std::mutex> lock(g_debug_mutex);
+            g_debug_wake.wait_for(lock, std::chrono::milliseconds(100), [] {
+                return g_debug_pending.load(std::memory_order_relaxed);
+            });
+        }
+        // Button edges made while paused take effect at the start of the step
+        apply_input_events();
+        notify_led_change();
+        return 0;
+    }
+    uint64_t n = normal;
+    switch (g_debug.step) {
+        case DEBUG_STEP_FRAME:
+            n = pixels_to(0, 0);
+            break;
+        case DEBUG_STEP_LINE:
+        case DEBUG_STEP_CYCLES:
+            n = g_debug.remaining;
+            break;
+        case DEBUG_UNTIL_LED:
+            n = 1;              // Stop on the exact pixel
+            break;
+        case DEBUG_UNTIL_PIXEL:
+            n = pixels_to(g_debug.pixel_x, g_debug.pixel_y);
+            break;
+        case DEBUG_UNTIL_FRAME:
+            n = pixels_to(0, 0);
+            break;
+        case DEBUG_UNTIL_CYCLE: {
+            uint64_t ticks = g_debug.target * 2 > main_time ? g_debug.target * 2 - main_time : 0;
+            uint64_t per_pixel = 2 * (uint64_t)g_timing.clocks_per_pixel;
+            n = std::max<uint64_t>(1, (ticks + per_pixel - 1) / per_pixel);
+            break;
+        }
+    }
+    return (int)std::min<uint64_t>(n, (uint64_t)std::min(normal, SAMPLE_BATCH));
+}
+
+// After a batch of n samples: pause if the active step has reached its target
+void debug_check_stop(const uint32_t* batch, int n) {
+    switch (g_debug.step) {
+        case DEBUG_STEP_FRAME:
+            if (g_vsync_count >= g_debug.target) debug_pause("Stepped one frame");
+            break;
+        case DEBUG_STEP_LINE:
+        case DEBUG_STEP_CYCLES:
+            g_debug.remaining -= std::min<uint64_t>(g_debug.remaining, n);
+            if (g_debug.remaining == 0) {
+                debug_pause(g_debug.step == DEBUG_STEP_LINE ? "Stepped one line" : "Stepped");
+            }
+            break;
+        case DEBUG_UNTIL_LED:
+            if (led_bits() != g_debug.leds) debug_pause("LEDs changed");
+            break;
+        case DEBUG_UNTIL_PIXEL:
+            if (coord_x == g_debug.pixel_x && coord_y == g_debug.pixel_y) {
+                int value = (int)(batch[n - 1] & 0xFFFF);
+                if (g_debug.pixel_value >= 0 && value != g_debug.pixel_value) {
+                    char text[64];
+                    snprintf(text, sizeof(text), "Pixel changed from %04x to %04x", g_debug.pixel_value, value);
+                    debug_pause(text);
+                }
+                g_debug.pixel_value = value;
+            }
+            break;
+        case DEBUG_UNTIL_FRAME:
+            if (g_vsync_count >= g_debug.target) debug_pause("Reached frame");
+            break;
+        case DEBUG_UNTIL_CYCLE:
+            if (main_time / 2 >= g_debug.target) debug_pause("Reached clock cycle");
+            break;
+    }
+}
+
+// Single-producer/single-consumer ring of sample batches for --pipeline. The
+// eval thread fills a slot in place and publishes it; the sampler thread
+// drains it in place. Only the two indices cross threads, each on its own
+// cache line.
+class SampleRing {
+public:
+    static const size_t SLOTS = 16;     // ~64 KB of samples in flight
     
-    // Reset key states
-    for (int i = 0; i < 5; i++) {
-        keys[i].store(1);
+    struct Slot {
+        uint32_t samples[SAMPLE_BATCH];
+        int count;
+        bool reset;                     // The model was reset before these samples
+        uint64_t end_time;              // main_time after the last sample
+    };
+    
+    // Producer: next free slot, or nullptr while the ring is full
+    Slot* write_slot() {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == SLOTS) return nullptr;
+        return &m_slots[head % SLOTS];
+    }
+    void publish() {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    // Producer: true once the consumer has finished with every published slot
+    bool drained() const {
+        return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_relaxed);
     }
     
-    // Reset LED states
-    for (int i = 0; i < 5; i++) {
-        leds_state[i].store(1);
+    // Consumer: oldest published slot, or nullptr while the ring is empty.
+    // Release it only after the last write of sampling state for it, so that a
+    // drained ring means the sampler is idle.
+    Slot* read_slot() {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) return nullptr;
+        return &m_slots[tail % SLOTS];
+    }
+    void release() {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    
+private:
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+    alignas(64) Slot m_slots[SLOTS];
+};
+static SampleRing g_sample_ring;
+static std::atomic<bool> g_eval_done{false};
+static std::atomic<bool> g_checkpoint_due{false};  // Sampler saw the checkpoint frame
+
+// Back off while the other end of the ring catches up: spin briefly, then sleep
+void ring_wait(int& idle) {
+    if (++idle < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
     }
 }
 
-// read VGA outputs and update graphics buffer
-void sample_pixel() {
-    coord_x = (coord_x + 1) % TOTAL_WIDTH;
+// Sampler thread for --pipeline: all sampling, framebuffer, hash and per-batch work
+void sampler_loop(uint64_t* idle_waits) {
+    std::cerr << "[Sampler] Sampler thread: "
+              << apply_thread_placement(g_options.sampler_cpu, 0, 0) << "\n";
+    int idle = 0;
+    while (!g_quit_requested.load(std::memory_order_acquire)) {
+        SampleRing::Slot* slot = g_sample_ring.read_slot();
+        if (!slot) {
+            if (g_eval_done.load(std::memory_order_acquire) && !g_sample_ring.read_slot()) break;
+            (*idle_waits)++;
+            ring_wait(idle);
+            continue;
+        }
+        idle = 0;
+        if (slot->reset) {
+            reset_sampler();
+        }
+        g_sampled_time = slot->end_time;
+        sample_batch(slot->samples, slot->count);
+        finish_batch();
+        if (g_rewind.enabled && g_vsync_count >= g_rewind.next_frame) {
+            g_checkpoint_due.store(true, std::memory_order_relaxed);
+        }
+        g_sample_ring.release();
+    }
+}
 
-    if(display->h_sync && !pre_h_sync){ // on positive edge of h_sync (active high)
-        coord_x = 0;
-        coord_y = (coord_y + 1) % TOTAL_HEIGHT;
+// --pipeline: this thread only evaluates the model, applies button edges and
+// packs samples; a second thread samples them. Batches end on the next button
+// edge as in run_serial(). When the sampler reaches a checkpoint frame, this
+// thread lets the ring drain and saves the checkpoint while the sampler is
+// idle. Returns the number of pixels evaluated.
+uint64_t run_pipelined() {
+    uint64_t pixels = 0;
+    uint64_t full_waits = 0;
+    uint64_t idle_waits = 0;
+    g_pipelined = true;
+    g_sampled_time = main_time;
+    g_eval_done.store(false, std::memory_order_relaxed);
+    g_checkpoint_due.store(false, std::memory_order_relaxed);
+    std::thread sampler(sampler_loop, &idle_waits);
+    
+    bool pending_reset = false;
+    int idle = 0;
+    while (!design_finished() && !g_quit_requested.load(std::memory_order_acquire) &&
+           !design_reload_due() && !g_debug_pending.load(std::memory_order_relaxed)) {
+        if (restart_triggered.exchange(false, std::memory_order_acquire)) {
+            std::cerr << "[SimThread] Reset triggered\n";
+            if (g_rewind.enabled) {
+                log_input(INPUT_RESET);
+            }
+            reset_model();
+            pending_reset = true;
+        }
+        if (g_checkpoint_due.load(std::memory_order_relaxed)) {
+            if (!g_sample_ring.drained()) {
+                full_waits++;
+                ring_wait(idle);
+                continue;
+            }
+            idle = 0;
+            take_checkpoint();
+            g_checkpoint_due.store(false, std::memory_order_relaxed);
+        }
+        SampleRing::Slot* slot = g_sample_ring.write_slot();
+        if (!slot) {
+            full_waits++;
+            ring_wait(idle);
+            continue;
+        }
+        idle = 0;
+        apply_input_events();
+        int n = input_batch_size(SAMPLE_BATCH);
+        run_pixels(slot->samples, n);
+        slot->count = n;
+        slot->reset = pending_reset;
+        slot->end_time = main_time;
+        pending_reset = false;
+        g_sample_ring.publish();
+        pixels += n;
     }
+    
+    g_eval_done.store(true, std::memory_order_release);
+    sampler.join();
+    g_pipelined = false;
+    std::cerr << "[Pipeline] Eval waits on a full ring: " << full_waits
+              << " | sampler waits on an empty ring: " << idle_waits << "\n";
+    return pixels;
+}
+
+// Evaluate and sample on this thread, one batch at a time. Returns the number
+// of pixels evaluated.
+uint64_t run_serial() {
+    uint64_t pixels = 0;
+    uint32_t batch[SAMPLE_BATCH + 2048];  // Line-aligned batches may exceed SAMPLE_BATCH
 
-    if(display->v_sync && !pre_v_sync){ // on positive edge of v_sync (active high)
-        coord_y = 0;
-        g_vsync_count++;
+    while (!design_finished() && !g_quit_requested.load(std::memory_order_acquire) &&
+           !design_reload_due()) {
+        if (restart_triggered.exchange(false, std::memory_order_acquire)) {
+            std::cerr << "[SimThread] Reset triggered\n";
+            if (g_rewind.enabled) {
+                log_input(INPUT_RESET);
+            }
+            reset();
+        }
         
-        // Output every 60 frames (~1 second)
-        if (g_vsync_count % 60 == 0) {
-            std::cerr << "[VGA] VSync #" << g_vsync_count 
-                      << " (frame " << (g_vsync_count / 60) << "s)\n";
+        // Evaluate one batch of pixels, then sample it in one go
+        int batch_size = next_batch_size();
+        bool debugging = g_debug.paused || g_debug.step != DEBUG_NONE ||
+                         g_debug_pending.load(std::memory_order_relaxed);
+        if (debugging && (batch_size = debug_batch_size(batch_size)) == 0) {
+            continue;
+        }
+        batch_size = input_batch_size(batch_size);
+        run_pixels(batch, batch_size);
+        sample_batch(batch, batch_size);
+        pixels += batch_size;
+        finish_batch();
+        if (g_debug.step != DEBUG_NONE) {
+            debug_check_stop(batch, batch_size);
+        }
+        if (g_rewind.enabled && g_vsync_count >= g_rewind.next_frame) {
+            take_checkpoint();
+        }
+        
+        // Yield CPU once per batch to prevent starving the render thread
+        // (not needed when the threads are pinned to different cores)
+        if (g_sim_yield) {
+            std::this_thread::yield();
         }
     }
+    return pixels;
+}
 
-    if(coord_x >= H_ACTIVE_START && coord_x < H_ACTIVE_START + ACTIVE_WIDTH && 
-       coord_y >= V_ACTIVE_START && coord_y < V_ACTIVE_START + ACTIVE_HEIGHT){
-        int x_index = coord_x - H_ACTIVE_START;
-        int y_index = coord_y - V_ACTIVE_START;
-        int rgb = display->rgb;
-        float* buf = write_buffer.load(std::memory_order_relaxed);
-        int idx = ((x_index * ACTIVE_HEIGHT) + y_index) * 3;
-        buf[idx] = RGB5_TO_FLOAT[(rgb >> 11) & 0x1F];
-        buf[idx + 1] = RGB6_TO_FLOAT[(rgb >> 5) & 0x3F];
-        buf[idx + 2] = RGB5_TO_FLOAT[rgb & 0x1F];
+// --diff: the reference design runs on its own thread, one batch behind a
+// barrier: the simulation thread hands it the batch size and the inputs, both
+// threads evaluate the same pixels in parallel, and the samples are compared
+// once both are done. The sequence number doubles as the go signal.
+static std::atomic<uint64_t> g_lockstep_go{0};
+static std::atomic<uint64_t> g_lockstep_done{0};
+static int g_lockstep_count = 0;
+static uint32_t g_reference_samples[SAMPLE_BATCH + 2048];
+const uint64_t LOCKSTEP_STOP = ~0ULL;
+
+void reference_loop() {
+    std::cerr << "[Diff] Reference thread: " << apply_thread_placement(g_options.reference_cpu, 0, 0) << "\n";
+    uint64_t seen = 0;
+    int idle = 0;
+    for (;;) {
+        uint64_t go = g_lockstep_go.load(std::memory_order_acquire);
+        if (go == seen) {
+            ring_wait(idle);
+            continue;
+        }
+        if (go == LOCKSTEP_STOP) break;
+        idle = 0;
+        seen = go;
+        g_reference_time = g_reference.api->run_pixels(g_reference.instance, &g_reference_ports, g_reference_time,
+                                                       g_timing.clocks_per_pixel, g_sync_invert,
+                                                       g_reference_samples, g_lockstep_count);
+        g_lockstep_done.store(go, std::memory_order_release);
+    }
+}
+
+// Compares the design against the reference pixel by pixel. The position is
+// counted from the reference's sync pulses the same way sample_pixel() does.
+// After the first divergence one more frame is recorded for the heatmap.
+struct LockstepDiff {
+    int x = 0, y = 0;
+    bool pre_h = false, pre_v = false;
+    uint64_t frames = 0;            // Reference v_sync pulses so far
+    bool diverged = false;
+    uint64_t remaining = 0;         // Pixels still to record after the divergence
+    uint64_t differing = 0;         // Differing active pixels among them
+    std::vector<uint16_t> reference, design;
+    std::vector<uint8_t> bits;      // Differing rgb bits per active pixel (0 = equal)
+    
+    void restart() {
+        x = y = 0;
+        pre_h = pre_v = false;
+    }
+    
+    void advance(uint32_t sample) {
+        bool h_sync = (sample & SAMPLE_H_SYNC) != 0;
+        bool v_sync = (sample & SAMPLE_V_SYNC) != 0;
+        x = (x + 1) % TOTAL_WIDTH;
+        if (h_sync && !pre_h) {
+            x = 0;
+            y = (y + 1) % TOTAL_HEIGHT;
+        }
+        if (v_sync && !pre_v) {
+            y = 0;
+            frames++;
+        }
+        pre_h = h_sync;
+        pre_v = v_sync;
+    }
+    
+    bool active() const {
+        return x >= H_ACTIVE_START && x < H_ACTIVE_START + ACTIVE_WIDTH &&
+               y >= V_ACTIVE_START && y < V_ACTIVE_START + ACTIVE_HEIGHT;
+    }
+    
+    void record(uint32_t ref, uint32_t dut) {
+        if (active()) {
+            size_t i = (size_t)(y - V_ACTIVE_START) * ACTIVE_WIDTH + (x - H_ACTIVE_START);
+            uint16_t changed = (uint16_t)(ref ^ dut);
+            int n = 0;
+            for (; changed; changed &= changed - 1) n++;
+            reference[i] = (uint16_t)ref;
+            design[i] = (uint16_t)dut;
+            bits[i] = (uint8_t)(n ? n : ((ref ^ dut) ? 1 : 0));  // Sync-only differences count too
+            if (ref != dut) differing++;
+        }
+        remaining--;
+    }
+    
+    void start(const std::string& what) {
+        std::cerr << "[Diff] First divergence: " << what << "\n";
+        diverged = true;
+        remaining = (uint64_t)TOTAL_WIDTH * TOTAL_HEIGHT;
+        size_t size = (size_t)ACTIVE_WIDTH * ACTIVE_HEIGHT;
+        reference.assign(size, 0);
+        design.assign(size, 0);
+        bits.assign(size, 0);
+    }
+};
+
+std::string format_sample(uint32_t s) {
+    char text[64];
+    snprintf(text, sizeof(text), "rgb %04x h_sync %d v_sync %d", (unsigned)(s & 0xFFFF),
+             (s & SAMPLE_H_SYNC) ? 1 : 0, (s & SAMPLE_V_SYNC) ? 1 : 0);
+    return text;
+}
+
+std::string format_leds(const VgaDesignPorts* ports) {
+    std::string text;
+    text += ports->led1 ? '1' : '0';
+    text += ports->led2 ? '1' : '0';
+    text += ports->led3 ? '1' : '0';
+    text += ports->led4 ? '1' : '0';
+    text += ports->led5 ? '1' : '0';
+    return text;
+}
+
+// Binary PPM, three panels side by side: reference, design, and the difference
+// in red (brighter = more rgb bits differ) over the dimmed reference
+bool write_diff_image(const LockstepDiff& diff, const std::string& path) {
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out << "P6\n" << ACTIVE_WIDTH * 3 << " " << ACTIVE_HEIGHT << "\n255\n";
+    std::vector<unsigned char> row((size_t)ACTIVE_WIDTH * 9);
+    for (int y = 0; y < ACTIVE_HEIGHT; y++) {
+        for (int x = 0; x < ACTIVE_WIDTH; x++) {
+            size_t i = (size_t)y * ACTIVE_WIDTH + x;
+            unsigned char* px[2] = {&row[x * 3], &row[(ACTIVE_WIDTH + x) * 3]};
+            uint16_t rgb[2] = {diff.reference[i], diff.design[i]};
+            for (int k = 0; k < 2; k++) {
+                px[k][0] = (unsigned char)(((rgb[k] >> 11) & 0x1F) * 255 / 31);
+                px[k][1] = (unsigned char)(((rgb[k] >> 5) & 0x3F) * 255 / 63);
+                px[k][2] = (unsigned char)((rgb[k] & 0x1F) * 255 / 31);
+            }
+            unsigned char* heat = &row[(ACTIVE_WIDTH * 2 + x) * 3];
+            if (diff.bits[i]) {
+                heat[0] = (unsigned char)std::min(255, 95 + diff.bits[i] * 10);
+                heat[1] = heat[2] = 0;
+            } else {
+                int gray = (px[0][0] + px[0][1] + px[0][2]) / 12;
+                heat[0] = heat[1] = heat[2] = (unsigned char)gray;
+            }
+        }
+        out.write((const char*)row.data(), (std::streamsize)row.size());
+    }
+    return (bool)out;
+}
+
+// --diff: run the design and the reference in lockstep and stop at the first
+// divergence. Returns the number of pixels evaluated.
+uint64_t run_lockstep() {
+    uint64_t pixels = 0;
+    uint64_t sequence = 0;
+    uint32_t batch[SAMPLE_BATCH + 2048];
+    LockstepDiff diff;
+    g_lockstep_go.store(0, std::memory_order_relaxed);
+    g_lockstep_done.store(0, std::memory_order_relaxed);
+    std::thread reference(reference_loop);
+    
+    while (!design_finished() && !g_quit_requested.load(std::memory_order_acquire) &&
+           !design_reload_due()) {
+        if (restart_triggered.exchange(false, std::memory_order_acquire)) {
+            std::cerr << "[SimThread] Reset triggered\n";
+            reset();
+            diff.restart();
+        }
+        
+        // Same inputs and pixel count for both; the reference starts first
+        int batch_size = next_batch_size();
+        bool debugging = g_debug.paused || g_debug.step != DEBUG_NONE ||
+                         g_debug_pending.load(std::memory_order_relaxed);
+        if (debugging && (batch_size = debug_batch_size(batch_size)) == 0) {
+            continue;
+        }
+        batch_size = input_batch_size(batch_size);
+        apply_input();
+        g_reference_ports.reset = display->reset;
+        g_reference_ports.B2 = display->B2;
+        g_reference_ports.B3 = display->B3;
+        g_reference_ports.B4 = display->B4;
+        g_reference_ports.B5 = display->B5;
+        g_lockstep_count = batch_size;
+        g_lockstep_go.store(++sequence, std::memory_order_release);
+        uint64_t start_time = main_time;
+        run_pixels(batch, batch_size);
+        int idle = 0;
+        while (g_lockstep_done.load(std::memory_order_acquire) != sequence) {
+            ring_wait(idle);
+        }
+        
+        for (int i = 0; i < batch_size; i++) {
+            uint32_t ref = g_reference_samples[i];
+            diff.advance(ref);
+            if (!diff.diverged && ref != batch[i]) {
+                std::ostringstream os;
+                os << "clock " << (start_time / 2 + (uint64_t)(i + 1) * g_timing.clocks_per_pixel)
+                   << ", frame " << diff.frames << " of the comparison, pixel (" << diff.x - H_ACTIVE_START << ", "
+                   << diff.y - V_ACTIVE_START << ")" << (diff.active() ? "" : " in blanking")
+                   << "\n[Diff]   reference " << format_sample(ref) << "\n[Diff]   design    " << format_sample(batch[i]);
+                diff.start(os.str());
+            }
+            if (diff.diverged && diff.remaining > 0) {
+                diff.record(ref, batch[i]);
+            }
+        }
+        if (!diff.diverged && format_leds(&g_reference_ports) != format_leds(display)) {
+            std::ostringstream os;
+            os << "LEDs by clock " << main_time / 2 << ", frame " << diff.frames << " of the comparison"
+               << "\n[Diff]   reference LEDs " << format_leds(&g_reference_ports)
+               << "\n[Diff]   design    LEDs " << format_leds(display);
+            diff.start(os.str());
+        }
+        
+        sample_batch(batch, batch_size);
+        pixels += batch_size;
+        finish_batch();
+        if (g_debug.step != DEBUG_NONE) {
+            debug_check_stop(batch, batch_size);
+        }
+        
+        if (diff.diverged && diff.remaining == 0) {
+            g_quit_requested.store(true, std::memory_order_release);
+        }
+    }
+    
+    g_lockstep_go.store(LOCKSTEP_STOP, std::memory_order_release);
+    reference.join();
+    if (!diff.diverged) {
+        std::cerr << "[Diff] No divergence from the reference in " << diff.frames << " frames\n";
+        return pixels;
+    }
+    // Also when the run ended before a whole frame was recorded
+    std::cerr << "[Diff] " << diff.differing << " of " << (uint64_t)ACTIVE_WIDTH * ACTIVE_HEIGHT
+              << " active pixels differ in the frame after the divergence\n";
+    if (write_diff_image(diff, g_options.diff_image)) {
+        std::cerr << "[Diff] Reference | design | difference written to " << g_options.diff_image << "\n";
+    } else {
+        std::cerr << "[Diff] Cannot write " << g_options.diff_image << "\n";
+    }
+    g_exit_code.store(EXIT_DIVERGED, std::memory_order_relaxed);
+    g_quit_requested.store(true, std::memory_order_release);
+    return pixels;
+}
+
+// Sampling profiler for --profile. SIGPROF interrupts the process every
+// PROFILE_INTERVAL_US of CPU time and the handler records the interrupted
+// program counter. run_simulation.sh --profile builds the design with
+// Verilator's --prof-cfuncs, so each sample lands in a function whose name
+// carries the Verilog file and line; rtl_profile.py turns the per-function
+// counts written here into per-instance and per-always-block tables.
+// The kernel may round the interval up to its tick (often 1-4 ms), so the
+// report uses the measured CPU time rather than samples * interval.
+const int PROFILE_INTERVAL_US = 1000;
+const size_t PROFILE_MAX_SAMPLES = 1 << 20;     // At least ~17 minutes of CPU time
+static uintptr_t g_profile_pcs[PROFILE_MAX_SAMPLES];
+static std::atomic<size_t> g_profile_count{0};
+static double g_profile_cpu_start = 0;
+
+#if !defined(_WIN32)
+static double process_cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+#endif
+
+#if !defined(_WIN32)
+static uintptr_t interrupted_pc(void* context) {
+    ucontext_t* uc = static_cast<ucontext_t*>(context);
+#if defined(__linux__) && defined(__x86_64__)
+    return (uintptr_t)uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(__linux__) && defined(__aarch64__)
+    return (uintptr_t)uc->uc_mcontext.pc;
+#elif defined(__APPLE__) && defined(__x86_64__)
+    return (uintptr_t)uc->uc_mcontext->__ss.__rip;
+#elif defined(__APPLE__) && defined(__aarch64__)
+    return (uintptr_t)uc->uc_mcontext->__ss.__pc;
+#else
+    (void)uc;
+    return 0;
+#endif
+}
+
+static void profile_signal(int, siginfo_t*, void* context) {
+    size_t i = g_profile_count.load(std::memory_order_relaxed);
+    if (i < PROFILE_MAX_SAMPLES) {
+        g_profile_pcs[i] = interrupted_pc(context);
+        g_profile_count.store(i + 1, std::memory_order_relaxed);
+    }
+}
+#endif
+
+bool start_profiler() {
+#if defined(_WIN32)
+    std::cerr << "[Profile] --profile is not supported on Windows\n";
+    return false;
+#else
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = profile_signal;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = PROFILE_INTERVAL_US;
+    timer.it_value = timer.it_interval;
+    if (sigaction(SIGPROF, &sa, nullptr) != 0 || setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        std::cerr << "[Profile] Cannot start the profiling timer: " << strerror(errno) << "\n";
+        return false;
     }
+    g_profile_cpu_start = process_cpu_seconds();
+    std::cerr << "[Profile] Sampling every " << PROFILE_INTERVAL_US << " us of CPU time\n";
+    return true;
+#endif
+}
 
-    // Mark buffer ready for swap at VSync
-    if(display->v_sync && !pre_v_sync){
-        buffer_swap_pending.store(true, std::memory_order_release);
+// Stop sampling and write "samples<TAB>design|host<TAB>where" lines, most
+// samples first. Design samples are written as offsets into the plugin, which
+// rtl_profile.py resolves against its full symbol table (dladdr() only sees
+// exported symbols and would blame the nearest one for static functions).
+// Must run while the design plugin is still loaded.
+void stop_profiler() {
+#if !defined(_WIN32)
+    struct itimerval off;
+    std::memset(&off, 0, sizeof(off));
+    setitimer(ITIMER_PROF, &off, nullptr);
+    signal(SIGPROF, SIG_IGN);
+    double cpu_seconds = process_cpu_seconds() - g_profile_cpu_start;
+    
+    Dl_info design_info;
+    const void* design_base = dladdr((const void*)g_design.api, &design_info) ? design_info.dli_fbase : nullptr;
+    std::map<std::string, uint64_t> counts;
+    size_t total = g_profile_count.load(std::memory_order_relaxed);
+    size_t in_design = 0;
+    for (size_t i = 0; i < total; i++) {
+        Dl_info info;
+        std::string name = "[unknown]";
+        bool design = false;
+        if (g_profile_pcs[i] && dladdr((const void*)g_profile_pcs[i], &info)) {
+            design = design_base && info.dli_fbase == design_base;
+            if (design) {
+                char offset[32];
+                snprintf(offset, sizeof(offset), "0x%llx",
+                         (unsigned long long)(g_profile_pcs[i] - (uintptr_t)design_base));
+                name = offset;
+            } else if (info.dli_sname) {
+                int status = 0;
+                char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+                name = status == 0 && demangled ? demangled : info.dli_sname;
+                free(demangled);
+            } else if (info.dli_fname) {
+                const char* slash = strrchr(info.dli_fname, '/');
+                name = std::string("[") + (slash ? slash + 1 : info.dli_fname) + "]";
+            }
+        }
+        in_design += design;
+        counts[std::string(design ? "design\t" : "host\t") + name]++;
+    }
+    
+    std::vector<std::pair<uint64_t, std::string> > sorted;
+    for (const auto& c : counts) sorted.push_back(std::make_pair(c.second, c.first));
+    std::sort(sorted.rbegin(), sorted.rend());
+    std::ofstream out(g_options.profile_path.c_str());
+    out << "# samples " << total << " cpu_seconds " << cpu_seconds
+        << " design " << g_options.design_path << "\n";
+    for (const auto& s : sorted) out << s.first << "\t" << s.second << "\n";
+    if (!out) {
+        std::cerr << "[Profile] Cannot write " << g_options.profile_path << "\n";
+        return;
+    }
+    std::cerr << "[Profile] " << total << " samples, " << (total ? in_design * 100 / total : 0)
+              << "% in the design, written to " << g_options.profile_path << "\n";
+    if (total == PROFILE_MAX_SAMPLES) {
+        std::cerr << "[Profile] Sample buffer full; later samples were dropped\n";
     }
+#endif
+}
 
-    pre_h_sync = display->h_sync;
-    pre_v_sync = display->v_sync;
+// Reset a freshly loaded design and settle the VGA mode (--mode or auto-detection)
+void start_design() {
+    reset();
+    if (g_options.timing_mode >= 0) {
+        const VgaTiming& mode = VESA_MODES[g_options.timing_mode];
+        set_timing(mode, true, true);
+        print_timing("Using");
+    } else {
+        run_timing_detection();
+        if (g_reference.instance) {
+            reset();    // Detection only ran the design; start both from reset
+        }
+    }
+    clear_checkpoints();    // Snapshots of another plugin cannot be restored
+    init_probes();
 }
+
 // simulation thread function
 void simulation_loop() {
     std::cerr << "[SimThread] Starting simulation loop...\n";
+    report_thread_placement(
+        apply_thread_placement(g_options.sim_cpu, g_options.sim_fifo_priority, g_options.sim_nice),
+        g_render_placement);
     
-    init_rgb_lookup_tables();
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
-    display = new VDevelopmentBoard;
-    reset();
-    
     // Statistics
-    uint64_t iteration_count = 0;
     auto sim_start_time = std::chrono::steady_clock::now();
-
-    while (!Verilated::gotFinish() && !g_quit_requested.load(std::memory_order_acquire)) {
-        if (restart_triggered.exchange(false, std::memory_order_acquire)) {
-            std::cerr << "[SimThread] Reset triggered\n";
-            reset();
+    uint64_t iteration_count = 0;
+    
+    bool profiling = !g_options.profile_path.empty() && start_profiler();
+    
+    // Runs until quit; with --watch-design each rebuilt plugin starts from reset
+    bool fresh_design = true;
+    for (;;) {
+        if (fresh_design) {
+            start_design();
         }
-        
-        tick();
-        tick();
-        sample_pixel();
-        iteration_count++;
-        
-        // Yield CPU periodically to prevent starving the render thread
-        if ((iteration_count & 0x3FF) == 0) {
-            std::this_thread::yield();
+        if (g_reference.instance) {
+            iteration_count += run_lockstep();
+        } else {
+            iteration_count += g_options.pipeline ? run_pipelined() : run_serial();
+        }
+        if (g_quit_requested.load(std::memory_order_acquire) || design_finished()) {
+            break;
         }
+        if (g_options.pipeline && g_debug_pending.load(std::memory_order_relaxed)) {
+            // Steps stop on an exact sample, which needs evaluation and sampling in step
+            std::cerr << "[Debug] Pausing and stepping run on one thread; leaving --pipeline\n";
+            g_options.pipeline = false;
+            fresh_design = false;
+            continue;
+        }
+        if (!g_options.watch_design) {
+            break;
+        }
+        fresh_design = reload_design();  // On failure the old design carries on
     }
 
     auto sim_end_time = std::chrono::steady_clock::now();
@@ -683,16 +4215,379 @@ void simulation_loop() {
     std::cerr << "Total iterations:    " << iteration_count << "\n";
     std::cerr << "Iterations/second:   " << (sim_duration > 0 ? iteration_count / sim_duration : 0) << "\n";
     std::cerr << "Final time stamp:    " << main_time << "\n";
+    // Two time steps per board clock; run_simulation.sh --release-perf reads this line
+    double sim_seconds = std::chrono::duration<double>(sim_end_time - sim_start_time).count();
+    char rate[64];
+    snprintf(rate, sizeof(rate), "%.2f MHz", sim_seconds > 0 ? main_time / 2 / sim_seconds / 1e6 : 0.0);
+    std::cerr << "Simulated clock:     " << rate << "\n";
+    print_rewind_stats(sim_seconds);
+    print_analyzer_stats();
     std::cerr << "=============================================\n";
+    if (g_signal_probes.csv.is_open()) {
+        g_signal_probes.csv.close();
+        std::cerr << "[Probes] " << g_signal_probes.csv_rows << " samples written to " << g_options.probe_csv << "\n";
+    }
     
-    display->final();
-    delete display;
+    if (profiling) {
+        stop_profiler();
+    }
+    unload_design(g_design);
+    if (g_reference.instance) {
+        unload_design(g_reference);
+    }
     
     std::cerr << "[SimThread] Simulation loop ended\n";
 }
 
+// --bench-sampler: feed a synthetic VGA stream for each VESA mode through the
+// generic and the specialised sampler and compare speed and output
+int run_sampler_benchmark(int frames) {
+    std::cerr << "[Bench] Sampler benchmark, " << frames << " frames per mode\n";
+    g_options.timing_report = 0;
+    bool all_match = true;
+    for (int m = 0; m < NUM_VESA_MODES; m++) {
+        const VgaTiming& t = VESA_MODES[m];
+        const int h_total = t.h_total();
+        const int v_total = t.v_total();
+        
+        // One frame plus the first line of the next, so the last v_sync edge is seen
+        std::vector<uint32_t> stream((size_t)h_total * (v_total + 1));
+        for (int y = 0; y <= v_total; y++) {
+            int line = y % v_total;
+            for (int x = 0; x < h_total; x++) {
+                uint32_t s = 0;
+                if (x < t.h_sync) s |= SAMPLE_H_SYNC;
+                if (line < t.v_sync) s |= SAMPLE_V_SYNC;
+                if (x >= t.h_start() && x < t.h_start() + t.h_active &&
+                    line >= t.v_start() && line < t.v_start() + t.v_active) {
+                    s |= (uint32_t)((x * 31 + line * 17) & 0xFFFF);
+                }
+                stream[(size_t)y * h_total + x] = s;
+            }
+        }
+        const size_t frame_len = (size_t)h_total * v_total;
+        
+        double ns_per_pixel[2] = {0, 0};
+        uint64_t hash[2] = {0, 0};
+        for (int pass = 0; pass < 2; pass++) {
+            g_options.generic_sampler = (pass == 0);
+            set_timing(t, true, true);
+            g_vsync_count = 0;
+            g_frame_hash = FNV_OFFSET;
+            write_buffer.store(buffer_a, std::memory_order_relaxed);
+            std::memset(buffer_a, 0, sizeof(buffer_a));
+            
+            // Feed in SAMPLE_BATCH-sized pieces like the simulation loop
+            auto start = std::chrono::steady_clock::now();
+            for (int f = 0; f < frames; f++) {
+                size_t len = f + 1 < frames ? frame_len : stream.size();
+                for (size_t i = 0; i < len; ) {
+                    size_t n = std::min((size_t)next_batch_size(), len - i);
+                    g_sample_batch(&stream[i], n);
+                    i += n;
+                }
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            ns_per_pixel[pass] = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() /
+                                 ((double)frame_len * frames);
+            hash[pass] = g_last_frame_hash;
+        }
+        g_options.generic_sampler = false;
+        
+        bool match = hash[0] == hash[1];
+        all_match = all_match && match;
+        char line[160];
+        snprintf(line, sizeof(line), "[Bench] %-11s generic %6.2f ns/px | fast %6.2f ns/px | %5.2fx | frame hash %s\n",
+                 t.name, ns_per_pixel[0], ns_per_pixel[1],
+                 ns_per_pixel[1] > 0 ? ns_per_pixel[0] / ns_per_pixel[1] : 0.0,
+                 match ? "match" : "MISMATCH");
+        std::cerr << line;
+    }
+    return all_match ? 0 : 1;
+}
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options] [+verilator+plusargs]\n"
+              << "  --latency-probe          Report input-to-display latency on exit\n"
+              << "  --autoclick=BUTTON       Click RESET/B2/B3/B4/B5 automatically (implies --latency-probe)\n"
+              << "  --autoclick-period=MS    Time between clicks (default 500)\n"
+              << "  --autoclick-hold=MS      How long each click is held (default 100)\n"
+              << "  --autoclick-count=N      Exit after N clicks (default 0 = until closed)\n"
+              << "  --mode=NAME              VGA mode instead of auto-detection (640x480@60, 640x400@70,\n"
+              << "                           640x350@70, 800x600@72; sync pulses active high)\n"
+              << "  --sim-cpu=N              Pin the simulation thread to CPU N\n"
+              << "  --render-cpu=N           Pin the render/event thread to CPU N\n"
+              << "  --sched=fifo[:PRIO]      Run the simulation thread SCHED_FIFO (default priority 10)\n"
+              << "  --nice=N                 Nice value for the simulation thread\n"
+              << "  --timing-report=FRAMES   Report measured sync timing every FRAMES frames (default 60, 0 = off)\n"
+              << "  --design=PATH            Design plugin to simulate (default obj_dir/design.so)\n"
+              << "  --watch-design           Reload the design plugin whenever PATH is rebuilt\n"
+              << "  --pipeline               Evaluate the model and sample its output on separate threads\n"
+              << "  --sampler-cpu=N          Pin the --pipeline sampler thread to CPU N\n"
+              << "  --generic-sampler        Disable the per-mode specialised pixel sampler\n"
+              << "  --bench-sampler[=FRAMES] Benchmark the pixel samplers on synthetic frames and exit\n"
+              << "  --headless               Run without a window (batch mode)\n"
+              << "  --frames=N               Exit after N frames (batch mode)\n"
+              << "  --watchdog=MS            Simulated time without sync edges before showing NO SIGNAL, or\n"
+              << "                           exiting with code 3 (no h_sync) / 4 (no v_sync) in batch mode\n"
+              << "                           (default 200, 0 = off)\n"
+              << "  --watchdog-frames=N      In batch mode, exit with code 5 after N identical frames (default off)\n"
+              << "  --hash-every=N           Print the frame hash every N frames, e.g. for comparing designs\n"
+              << "  --diff=PLUGIN            Run the reference design PLUGIN in lockstep with --design and exit\n"
+              << "                           with code 6 at the first difference in sync, rgb or LEDs\n"
+              << "  --diff-image=FILE        Reference/design/difference image written then (default diff_frame.ppm)\n"
+              << "  --reference-cpu=N        Pin the --diff reference thread to CPU N\n"
+              << "  --input-script=FILE      Press and release buttons at given frames, one \"FRAME BUTTON press|release\"\n"
+              << "                           per line\n"
+              << "  --pixel-check=FILE       Check every frame against \"COLOR X0 Y0 X1 Y1 MIN MAX\" pixel counts, one per\n"
+              << "                           line; in batch mode exit with code 7 at the first failure\n"
+              << "  --strict-timing          In batch mode, exit with code 7 at the first timing report with a violation\n"
+              << "  --turbo[=N]              Start in fast-forward mode (T key): draw only every Nth frame\n"
+              << "                           (default 60, 0 = none) so the design runs at full speed\n"
+              << "  --turbo-until=FRAME      Fast-forward without drawing until frame FRAME, then run normally\n"
+              << "  --paused                 Pause once the design has started (P key resumes)\n"
+              << "  --run-until=COND         Run until COND, then pause (or exit in --headless runs): led (any LED\n"
+              << "                           changes), pixel:X,Y (that active-area pixel changes), frame:N or cycle:N\n"
+              << "  --step-cycles=N          Clock cycles per C key step (default 1, rounded up to whole pixels)\n"
+              << "  --watch-pixel=X,Y        Pixel for the X key, run until it changes (default: centre of the screen)\n"
+              << "  --checkpoint-every=FRAMES  Keep a model snapshot every FRAMES frames for rewinding with the Left /\n"
+              << "                           Page Up keys (default 60, 0 = off)\n"
+              << "  --checkpoint-mb=MB       Memory for rewind snapshots; the oldest are dropped beyond it (default 256)\n"
+              << "  --probe-every=WHEN       Sample the probes.txt signals once per frame (default) or line\n"
+              << "  --probe-csv=FILE         Write every probe sample to FILE as frame,line,clock,values...\n"
+              << "  --analyzer[=MB]          Show a logic analyzer for sync, colour and button signals below the\n"
+              << "                           buttons, keeping up to MB of edges (default 32)\n"
+              << "  --profile[=FILE]         Sample the CPU time per function while simulating and write it to\n"
+              << "                           FILE (default profile_samples.txt); use with --headless\n"
+              << "  --help                   Show this message\n";
+}
+
+// Parse --name=value options; unknown arguments are left for Verilator
+bool parse_options(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) continue;
+        size_t eq = arg.find('=');
+        std::string name = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        
+        if (name == "help") {
+            print_usage(argv[0]);
+            return false;
+        } else if (name == "latency-probe") {
+            g_options.latency_probe = true;
+        } else if (name == "autoclick") {
+            g_options.autoclick_button = parse_button(value);
+            if (g_options.autoclick_button < 0) {
+                std::cerr << "Unknown button for --autoclick: '" << value << "'\n";
+                return false;
+            }
+            g_options.latency_probe = true;
+        } else if (name == "autoclick-period") {
+            g_options.autoclick_period_ms = std::max(2, atoi(value.c_str()));
+        } else if (name == "autoclick-hold") {
+            g_options.autoclick_hold_ms = std::max(1, atoi(value.c_str()));
+        } else if (name == "autoclick-count") {
+            g_options.autoclick_count = std::max(0, atoi(value.c_str()));
+        } else if (name == "mode") {
+            g_options.timing_mode = -1;
+            for (int m = 0; m < NUM_VESA_MODES; m++) {
+                if (value == VESA_MODES[m].name) g_options.timing_mode = m;
+            }
+            if (g_options.timing_mode < 0 && value != "auto") {
+                std::cerr << "Unknown VGA mode for --mode: '" << value << "'\n";
+                return false;
+            }
+        } else if (name == "sim-cpu") {
+            g_options.sim_cpu = atoi(value.c_str());
+        } else if (name == "render-cpu") {
+            g_options.render_cpu = atoi(value.c_str());
+        } else if (name == "sched") {
+            if (value.compare(0, 4, "fifo") != 0) {
+                std::cerr << "Unknown scheduling policy for --sched: '" << value << "'\n";
+                return false;
+            }
+            g_options.sim_fifo_priority = value.size() > 5 ? std::max(1, atoi(value.c_str() + 5)) : 10;
+        } else if (name == "nice") {
+            g_options.sim_nice = atoi(value.c_str());
+        } else if (name == "timing-report") {
+            g_options.timing_report = std::max(0, atoi(value.c_str()));
+        } else if (name == "headless") {
+            g_options.headless = true;
+        } else if (name == "frames") {
+            g_options.frames = strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "watchdog") {
+            g_options.watchdog_ms = std::max(0, atoi(value.c_str()));
+        } else if (name == "watchdog-frames") {
+            g_options.watchdog_frames = std::max(0, atoi(value.c_str()));
+        } else if (name == "design") {
+            g_options.design_path = value;
+        } else if (name == "watch-design") {
+            g_options.watch_design = true;
+        } else if (name == "pipeline") {
+            g_options.pipeline = true;
+        } else if (name == "sampler-cpu") {
+            g_options.sampler_cpu = atoi(value.c_str());
+        } else if (name == "generic-sampler") {
+            g_options.generic_sampler = true;
+        } else if (name == "profile") {
+            g_options.profile_path = value.empty() ? "profile_samples.txt" : value;
+        } else if (name == "hash-every") {
+            g_options.hash_every = std::max(0, atoi(value.c_str()));
+        } else if (name == "diff") {
+            g_options.diff_path = value;
+        } else if (name == "diff-image") {
+            g_options.diff_image = value;
+        } else if (name == "reference-cpu") {
+            g_options.reference_cpu = atoi(value.c_str());
+        } else if (name == "pixel-check") {
+            g_options.pixel_check = value;
+        } else if (name == "strict-timing") {
+            g_options.strict_timing = true;
+        } else if (name == "turbo") {
+            g_options.turbo = true;
+            g_options.turbo_every = value.empty() ? 60 : std::max(0, atoi(value.c_str()));
+        } else if (name == "turbo-until") {
+            g_options.turbo_until = strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "paused") {
+            g_options.paused = true;
+        } else if (name == "step-cycles") {
+            g_options.step_cycles = std::max(1ULL, strtoull(value.c_str(), nullptr, 10));
+        } else if (name == "watch-pixel") {
+            if (sscanf(value.c_str(), "%d,%d", &g_options.watch_pixel_x, &g_options.watch_pixel_y) != 2 ||
+                g_options.watch_pixel_x < 0 || g_options.watch_pixel_y < 0) {
+                std::cerr << "Expected --watch-pixel=X,Y, got '" << value << "'\n";
+                return false;
+            }
+        } else if (name == "run-until") {
+            int x = 0, y = 0;
+            unsigned long long n = 0;
+            if (value == "led") {
+                g_options.run_until = DEBUG_UNTIL_LED;
+            } else if (sscanf(value.c_str(), "pixel:%d,%d", &x, &y) == 2 && x >= 0 && y >= 0) {
+                g_options.run_until = DEBUG_UNTIL_PIXEL;
+                g_options.run_until_arg = ((uint64_t)x << 32) | (uint32_t)y;
+            } else if (sscanf(value.c_str(), "frame:%llu", &n) == 1) {
+                g_options.run_until = DEBUG_UNTIL_FRAME;
+                g_options.run_until_arg = n;
+            } else if (sscanf(value.c_str(), "cycle:%llu", &n) == 1) {
+                g_options.run_until = DEBUG_UNTIL_CYCLE;
+                g_options.run_until_arg = n;
+            } else {
+                std::cerr << "Expected --run-until=led, pixel:X,Y, frame:N or cycle:N, got '" << value << "'\n";
+                return false;
+            }
+        } else if (name == "checkpoint-every") {
+            g_options.checkpoint_every = std::max(0, atoi(value.c_str()));
+        } else if (name == "checkpoint-mb") {
+            g_options.checkpoint_mb = std::max(1, atoi(value.c_str()));
+        } else if (name == "probe-every") {
+            if (value != "line" && value != "frame") {
+                std::cerr << "Expected --probe-every=line or frame, got '" << value << "'\n";
+                return false;
+            }
+            g_options.probe_per_line = value == "line";
+        } else if (name == "probe-csv") {
+            g_options.probe_csv = value;
+        } else if (name == "analyzer") {
+            g_options.analyzer_mb = value.empty() ? 32 : std::max(1, atoi(value.c_str()));
+        } else if (name == "input-script") {
+            g_options.input_script = value;
+        } else if (name == "bench-sampler") {
+            g_options.bench_sampler_frames = value.empty() ? 30 : std::max(1, atoi(value.c_str()));
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    if (g_options.autoclick_hold_ms >= g_options.autoclick_period_ms) {
+        g_options.autoclick_hold_ms = g_options.autoclick_period_ms / 2;
+    }
+    return true;
+}
+
+// Built without main() when another front end includes this file (pyvga.cpp)
+#ifndef VGA_SIM_NO_MAIN
 int main(int argc, char** argv) {
-    Verilated::commandArgs(argc, argv);   // remember args
+    if (!parse_options(argc, argv)) {
+        return 2;
+    }
+    if (g_options.bench_sampler_frames > 0) {
+        return run_sampler_benchmark(g_options.bench_sampler_frames);
+    }
+    
+    std::string script_error;
+    if (!g_options.input_script.empty() && !load_input_script(g_options.input_script, script_error)) {
+        std::cerr << "Failed to load --input-script: " << script_error << "\n";
+        return 2;
+    }
+    if (!g_options.pixel_check.empty() && !load_pixel_checks(g_options.pixel_check, script_error)) {
+        std::cerr << "Failed to load --pixel-check: " << script_error << "\n";
+        return 2;
+    }
+    
+    // Load the design; the full command line goes to the plugin for +verilator+ plusargs
+    g_design_args.assign(argv, argv + argc);
+    g_design_args.push_back(nullptr);
+    g_design_file_loaded = g_design_file_last = stat_design_file();
+    std::string design_error;
+    if (!load_design(g_options.design_path, g_design, design_error)) {
+        std::cerr << "Failed to load design plugin " << g_options.design_path << ": " << design_error << "\n"
+                  << "Build it with run_simulation.sh\n";
+        return 1;
+    }
+    if (!g_options.diff_path.empty()) {
+        if (!load_design(g_options.diff_path, g_reference, design_error)) {
+            std::cerr << "Failed to load reference plugin " << g_options.diff_path << ": " << design_error << "\n";
+            return 1;
+        }
+        if (g_options.pipeline) {
+            std::cerr << "[Diff] --pipeline is ignored; the reference runs on the second thread\n";
+        }
+        std::cerr << "[Diff] Comparing " << g_options.design_path << " against " << g_options.diff_path << "\n";
+    }
+    // Fast-forward skips frames, so not with batch runs or options that look at every frame
+    bool turbo_requested = g_options.turbo || g_options.turbo_until > 0;
+    g_turbo_allowed = !g_options.headless && g_options.frames == 0 && g_options.hash_every == 0 &&
+                      !g_options.latency_probe && g_pixel_checks.empty();
+    if (turbo_requested && !g_turbo_allowed) {
+        std::cerr << "[Turbo] Ignored in batch runs and with --hash-every, --latency-probe or --pixel-check\n";
+    }
+    g_turbo.store(turbo_requested && g_turbo_allowed);
+    
+    // Rewinding needs the serial loop and a window to look at the result
+    g_rewind.enabled = g_options.checkpoint_every > 0 && !g_options.headless && g_options.frames == 0 &&
+                       g_options.diff_path.empty();
+    
+    // Probes are read between batches on the simulation thread
+    int probe_count = g_design.api->probe_count(g_design.instance);
+    if (probe_count > 0 && g_options.pipeline && g_options.diff_path.empty()) {
+        std::cerr << "[Probes] Not sampled with --pipeline, where the model runs during sampling\n";
+    }
+    
+    // Picked up by the simulation thread once the design has started
+    if (g_options.run_until != DEBUG_NONE) {
+        post_debug_command(g_options.run_until, g_options.run_until_arg);
+    } else if (g_options.paused && g_options.headless) {
+        std::cerr << "[Debug] --paused is ignored with --headless\n";
+    } else if (g_options.paused) {
+        post_debug_command(DEBUG_PAUSE, 0);
+    }
+    
+    if (g_options.analyzer_mb > 0 && g_options.headless) {
+        std::cerr << "[Analyzer] --analyzer is ignored with --headless\n";
+    } else if (g_options.analyzer_mb > 0) {
+        g_analyzer.enabled = true;
+        g_analyzer.budget = (size_t)g_options.analyzer_mb << 20;
+    }
+    
+    if (g_options.headless) {
+        // No SDL at all: simulate on this thread until --frames, the watchdog or $finish
+        g_render_placement = "none (headless)";
+        simulation_loop();
+        return g_exit_code.load();
+    }
     
     // 1. Initialize SDL (must be on main thread)
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
@@ -701,9 +4596,13 @@ int main(int argc, char** argv) {
     }
     
     // 2. Create window (add ALLOW_HIGHDPI for macOS Retina support)
-    g_window = SDL_CreateWindow("VGA and LED Simulator (SDL2) - Press ESC or Q to exit",
+    //    The design's probes get a plot panel to the right of the VGA area, the
+    //    logic analyzer a panel below the buttons
+    int window_w = probe_count > 0 ? 800 + PROBE_PANEL_WIDTH : 800;
+    int window_h = g_analyzer.enabled ? 850 + ANALYZER_PANEL_HEIGHT : 850;
+    g_window = SDL_CreateWindow(WINDOW_TITLE.c_str(),
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        800, 850,
+        window_w, window_h,
         SDL_WINDOW_SHOWN | SDL_WINDOW_ALLOW_HIGHDPI);
         
     if (!g_window) {
@@ -714,12 +4613,23 @@ int main(int argc, char** argv) {
     
     g_screen_surface = SDL_GetWindowSurface(g_window);
     
+    // Register the frame-ready event before the simulation thread can post it
+    g_frame_ready_event = SDL_RegisterEvents(1);
+    SDL_AddEventWatch(keyboard_event_watch, nullptr);
+    
     // Get actual surface size (handle macOS Retina and other HiDPI screens)
     g_window_width = g_screen_surface->w;
     g_window_height = g_screen_surface->h;
     std::cout << "Window surface size: " << g_window_width << "x" << g_window_height << std::endl;
+    if (probe_count > 0) {
+        g_probe_panel_width = PROBE_PANEL_WIDTH * g_window_width / window_w;
+    }
+    if (g_analyzer.enabled) {
+        g_analyzer_panel_height = ANALYZER_PANEL_HEIGHT * g_window_height / window_h;
+    }
     
-    // 3. Create VGA buffer surface (32-bit RGB888, cross-platform safe)
+    // 3. Create VGA buffer surface (32-bit RGB888, cross-platform safe); it is
+    //    recreated at the detected mode's size when the first frame arrives
     g_vga_surface = SDL_CreateRGBSurfaceWithFormat(0, ACTIVE_WIDTH, ACTIVE_HEIGHT, 
         32, SDL_PIXELFORMAT_RGB888);
     if (!g_vga_surface) {
@@ -728,8 +4638,10 @@ int main(int argc, char** argv) {
         SDL_Quit();
         return 1;
     }
+    init_rgb_lookup_table(g_vga_surface->format);
     
-    // 4. Start simulation thread (after SDL initialization)
+    // 4. Start simulation thread (after SDL initialization); it reports the thread placement
+    g_render_placement = apply_thread_placement(g_options.render_cpu, 0, 0);
     g_sim_thread = std::thread(simulation_loop);
 
     // 5. Run event loop (main thread)
@@ -738,5 +4650,6 @@ int main(int argc, char** argv) {
     // 6. Cleanup (unified path, no platform checks needed)
     cleanup_simulation();
     
-    return 0;
+    return g_exit_code.load();
 }
+#endif // VGA_SIM_NO_MAIN